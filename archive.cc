@@ -0,0 +1,162 @@
+#include "archive.h"
+
+#include <chrono>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "history_block.h"
+#include "time_utils.h"
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+int OpenOrComplain(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cout << "Could not open archive '" << path << "'.\n";
+  }
+  return fd;
+}
+
+} // namespace
+
+HistoryArchive::HistoryArchive(const std::string &path)
+    : path_(path), data_fd_(OpenOrComplain(path)),
+      index_fd_(OpenOrComplain(path + ".index")) {}
+
+HistoryArchive::~HistoryArchive() {
+  if (data_fd_ >= 0) {
+    close(data_fd_);
+  }
+  if (index_fd_ >= 0) {
+    close(index_fd_);
+  }
+}
+
+bool HistoryArchive::Put(const std::string &day,
+                         const std::vector<Done> &history) {
+  // The todo list of an imported day stays.
+  TodayHistoryProto block = Day(day);
+  block.set_day(day);
+  block.clear_done();
+  for (const Done &done : history) {
+    *block.add_done() = done;
+  }
+  return Put(block);
+}
+
+bool HistoryArchive::Put(const TodayHistoryProto &history) {
+  const std::optional<int> day_number = ParseDay(history.day());
+  if (!day_number || *day_number < 0 || data_fd_ < 0 || index_fd_ < 0) {
+    return false;
+  }
+  std::string data;
+  if (!EncodeHistoryBlock(history, &data)) {
+    data = history.SerializeAsString();
+  }
+
+  // Blocks are only ever appended. The slot is written after the block, so a
+  // crash in between leaves the previous version of the day in place.
+  struct stat st;
+  if (fstat(data_fd_, &st) != 0) {
+    return false;
+  }
+  const Slot slot = {.offset = static_cast<uint64_t>(st.st_size),
+                     .length = data.size()};
+  if (pwrite(data_fd_, data.data(), data.size(), slot.offset) !=
+      static_cast<ssize_t>(data.size())) {
+    std::cout << "Could not write to archive '" << path_ << "'.\n";
+    return false;
+  }
+
+  uint8_t buf[kSlotSize];
+  uint8_t *end = CodedOutputStream::WriteLittleEndian64ToArray(slot.offset, buf);
+  CodedOutputStream::WriteLittleEndian64ToArray(slot.length, end);
+  return pwrite(index_fd_, buf, kSlotSize,
+                static_cast<off_t>(*day_number) * kSlotSize) == kSlotSize;
+}
+
+TodayHistoryProto HistoryArchive::Day(const std::string &day) const {
+  std::vector<TodayHistoryProto> days = Range(day, day);
+  if (days.empty()) {
+    TodayHistoryProto empty;
+    empty.set_day(day);
+    return empty;
+  }
+  return std::move(days.front());
+}
+
+std::vector<TodayHistoryProto>
+HistoryArchive::Range(const std::string &first, const std::string &last) const {
+  const std::optional<int> first_number = ParseDay(first);
+  const std::optional<int> last_number = ParseDay(last);
+  if (!first_number || !last_number) {
+    return {};
+  }
+  return RangeByNumber(*first_number, *last_number);
+}
+
+std::vector<TodayHistoryProto>
+HistoryArchive::Week(const std::string &day) const {
+  const std::optional<int> day_number = ParseDay(day);
+  if (!day_number) {
+    return {};
+  }
+  const std::chrono::weekday weekday{
+      std::chrono::sys_days{std::chrono::days{*day_number}}};
+  const int monday = *day_number - (weekday.iso_encoding() - 1);
+  return RangeByNumber(monday, monday + 6);
+}
+
+std::vector<TodayHistoryProto> HistoryArchive::RangeByNumber(int first,
+                                                             int last) const {
+  std::vector<TodayHistoryProto> days;
+  first = std::max(first, 0);
+  if (index_fd_ < 0 || last < first) {
+    return days;
+  }
+
+  // All slots of the range in one read. Reading past the end of the index
+  // returns fewer bytes; those days are simply not stored.
+  const int count = last - first + 1;
+  std::vector<uint8_t> slots(static_cast<size_t>(count) * kSlotSize);
+  const ssize_t n = pread(index_fd_, slots.data(), slots.size(),
+                          static_cast<off_t>(first) * kSlotSize);
+  for (ssize_t pos = 0; pos + kSlotSize <= n; pos += kSlotSize) {
+    CodedInputStream input(slots.data() + pos, kSlotSize);
+    Slot slot;
+    input.ReadLittleEndian64(&slot.offset);
+    input.ReadLittleEndian64(&slot.length);
+    if (slot.length == 0) {
+      continue;
+    }
+    TodayHistoryProto history;
+    if (ReadBlock(slot, &history)) {
+      days.push_back(std::move(history));
+    }
+  }
+  return days;
+}
+
+bool HistoryArchive::ReadBlock(const Slot &slot,
+                               TodayHistoryProto *history) const {
+  std::string data(slot.length, '\0');
+  if (pread(data_fd_, data.data(), data.size(), slot.offset) !=
+      static_cast<ssize_t>(data.size())) {
+    return false;
+  }
+  // Blocks written before the columnar encoding are serialized protos.
+  if (IsHistoryBlock(data) ? !DecodeHistoryBlock(data, history)
+                           : !history->ParseFromString(data)) {
+    return false;
+  }
+  for (Done &done : *history->mutable_done()) {
+    UpgradeDoneTimes(history->day(), &done);
+  }
+  return true;
+}
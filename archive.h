@@ -0,0 +1,57 @@
+#ifndef POMODORO_ARCHIVE_H_
+#define POMODORO_ARCHIVE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "state.pb.h"
+
+// On-disk archive of the history of past days.
+//
+// `path` holds one block per day, a TodayHistoryProto encoded column by column
+// as described in history_block.h. `path`.index is an array of fixed-size
+// slots, one per day since 1970-01-01, each holding the offset and length of
+// that day's block. Looking up a day is therefore a single read at a computed
+// offset, and a range of days is one read of consecutive slots. Unused slots
+// are holes in a sparse file.
+class HistoryArchive {
+public:
+  explicit HistoryArchive(const std::string &path);
+  ~HistoryArchive();
+  HistoryArchive(const HistoryArchive &) = delete;
+  HistoryArchive &operator=(const HistoryArchive &) = delete;
+
+  // Stores the complete history of `day`, replacing the Dones stored before.
+  // A todo list stored with the day is kept. Storing the same day twice is
+  // harmless. Returns false on errors.
+  bool Put(const std::string &day, const std::vector<Done> &history);
+  // Stores `history` as the block of its day, like Put() above.
+  bool Put(const TodayHistoryProto &history);
+
+  // The history of `day`, empty if nothing is stored.
+  TodayHistoryProto Day(const std::string &day) const;
+  // All stored days from `first` to `last`, both inclusive, in order.
+  std::vector<TodayHistoryProto> Range(const std::string &first,
+                                       const std::string &last) const;
+  // The stored days of the Monday-to-Sunday week containing `day`.
+  std::vector<TodayHistoryProto> Week(const std::string &day) const;
+
+  // Stored days from `first` to `last` (days since 1970-01-01), inclusive.
+  std::vector<TodayHistoryProto> RangeByNumber(int first, int last) const;
+
+private:
+  struct Slot {
+    uint64_t offset;
+    uint64_t length;
+  };
+  static constexpr int kSlotSize = 2 * sizeof(uint64_t);
+
+  bool ReadBlock(const Slot &slot, TodayHistoryProto *history) const;
+
+  std::string path_;
+  int data_fd_;
+  int index_fd_;
+};
+
+#endif // POMODORO_ARCHIVE_H_
@@ -0,0 +1,172 @@
+#include "benchmark.h"
+
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+constexpr std::chrono::milliseconds kMinTime(500);
+
+std::atomic<int64_t> allocations{0};
+
+} // namespace
+
+// Count heap allocations of the whole binary. With glibc, C allocations,
+// e.g. those of ncurses, are counted too, through glibc's __libc_*
+// entry points, and every form of operator new goes through malloc or
+// aligned_alloc. Elsewhere only operator new is counted, in all its forms.
+#ifdef __GLIBC__
+extern "C" {
+void *__libc_malloc(std::size_t size);
+void *__libc_calloc(std::size_t count, std::size_t size);
+void *__libc_realloc(void *ptr, std::size_t size);
+void *__libc_memalign(std::size_t alignment, std::size_t size);
+
+void *malloc(std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_malloc(size);
+}
+void *calloc(std::size_t count, std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_calloc(count, size);
+}
+void *realloc(void *ptr, std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_realloc(ptr, size);
+}
+void *memalign(std::size_t alignment, std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+void *aligned_alloc(std::size_t alignment, std::size_t size) {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  return __libc_memalign(alignment, size);
+}
+int posix_memalign(void **ptr, std::size_t alignment, std::size_t size) {
+  if (alignment % sizeof(void *) != 0 ||
+      (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  void *result = __libc_memalign(alignment, size);
+  if (!result) {
+    return ENOMEM;
+  }
+  *ptr = result;
+  return 0;
+}
+}
+#else
+namespace {
+
+void *Allocate(std::size_t size, std::size_t alignment) noexcept {
+  allocations.fetch_add(1, std::memory_order_relaxed);
+  size = size == 0 ? 1 : size;
+  if (alignment <= __STDCPP_DEFAULT_NEW_ALIGNMENT__) {
+    return std::malloc(size);
+  }
+  // aligned_alloc wants a multiple of the alignment.
+  return std::aligned_alloc(alignment,
+                            (size + alignment - 1) / alignment * alignment);
+}
+
+void *AllocateOrThrow(std::size_t size, std::size_t alignment) {
+  if (void *ptr = Allocate(size, alignment)) {
+    return ptr;
+  }
+  throw std::bad_alloc();
+}
+
+} // namespace
+
+void *operator new(std::size_t size) {
+  return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](std::size_t size) {
+  return AllocateOrThrow(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new(std::size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment) {
+  return AllocateOrThrow(size, static_cast<std::size_t>(alignment));
+}
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return Allocate(size, __STDCPP_DEFAULT_NEW_ALIGNMENT__);
+}
+void *operator new(std::size_t size, std::align_val_t alignment,
+                   const std::nothrow_t &) noexcept {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+void *operator new[](std::size_t size, std::align_val_t alignment,
+                     const std::nothrow_t &) noexcept {
+  return Allocate(size, static_cast<std::size_t>(alignment));
+}
+
+void operator delete(void *ptr) noexcept { std::free(ptr); }
+void operator delete[](void *ptr) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::size_t) noexcept { std::free(ptr); }
+void operator delete(void *ptr, std::align_val_t) noexcept { std::free(ptr); }
+void operator delete[](void *ptr, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, std::size_t, std::align_val_t) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+void operator delete(void *ptr, std::align_val_t,
+                     const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+void operator delete[](void *ptr, std::align_val_t,
+                       const std::nothrow_t &) noexcept {
+  std::free(ptr);
+}
+#endif
+
+void RunBenchmark(const std::string &name, int64_t ops,
+                  const std::function<void()> &fn) {
+  using Clock = std::chrono::steady_clock;
+
+  // Warm up caches and lazily initialized state.
+  fn();
+
+  int64_t iterations = 0;
+  const int64_t allocations_before = allocations.load();
+  const Clock::time_point start = Clock::now();
+  Clock::duration elapsed;
+  do {
+    fn();
+    ++iterations;
+    elapsed = Clock::now() - start;
+  } while (elapsed < kMinTime);
+
+  const double total_ops = static_cast<double>(iterations) * ops;
+  const double allocations_per_op =
+      (allocations.load() - allocations_before) / total_ops;
+  const std::chrono::duration<double, std::nano> ns = elapsed;
+  std::printf("%-48s %12.1f ns/op %10.2f allocs/op %8lld iterations\n",
+              name.c_str(), ns.count() / total_ops, allocations_per_op,
+              static_cast<long long>(iterations));
+}
+
+void ReportValue(const std::string &name, double value,
+                 const std::string &unit) {
+  std::printf("%-48s %12.1f %s\n", name.c_str(), value, unit.c_str());
+}
@@ -0,0 +1,27 @@
+#ifndef POMODORO_BENCHMARK_H_
+#define POMODORO_BENCHMARK_H_
+
+#include <cstdint>
+#include <functional>
+#include <string>
+
+// A minimal benchmark harness for the benchmarks binary.
+
+// Calls `fn` repeatedly for a fixed minimum time and prints the time and the
+// heap allocations per operation. Allocations are those of operator new and,
+// with glibc, of the C allocators: malloc, calloc, realloc and the aligned
+// ones. `ops` is the number of operations a single call performs, e.g. the
+// number of records it parses.
+void RunBenchmark(const std::string &name, int64_t ops,
+                  const std::function<void()> &fn);
+
+// Prints a value that is not a timing, e.g. bytes per record.
+void ReportValue(const std::string &name, double value,
+                 const std::string &unit);
+
+// Keeps the compiler from optimizing away the computation of `value`.
+template <typename T> void DoNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+#endif // POMODORO_BENCHMARK_H_
@@ -0,0 +1,748 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "archive.h"
+#include "benchmark.h"
+#include "channel.h"
+#include "daemon.h"
+#include "event_loop.h"
+#include "flat_state.h"
+#include "history_block.h"
+#include "history_stats.h"
+#include "importer.h"
+#include "report.h"
+#include "screen.h"
+#include "search.h"
+#include "simulation.h"
+#include "state.h"
+#include "state.pb.h"
+#include "status_page.h"
+#include "status_writer.h"
+#include "storage.h"
+#include "team_load.h"
+#include "team_server.h"
+#include "time_utils.h"
+#include "timer_wheel.h"
+#include "todo_list.h"
+#include "ui.h"
+
+namespace {
+
+constexpr int kRecords = 100000;
+constexpr int64_t kStartUs = 1618819200000000; // 2021-04-19 08:00 UTC.
+
+// A day worth of history, repeated. `legacy` uses the "HH:MM" strings
+// written before timestamps were stored as integers.
+TodayHistoryProto MakeHistory(bool legacy) {
+  TodayHistoryProto history;
+  history.set_day("2021-04-19");
+  for (int i = 0; i < kRecords; ++i) {
+    Done *done = history.add_done();
+    done->set_done_type(i % 2 == 0 ? Done::WORK : Done::BREAK);
+    done->set_todo("Write the quarterly report");
+    done->set_duration_seconds(i % 2 == 0 ? 25 * 60 : 5 * 60);
+    const int64_t start_us = kStartUs + int64_t{i % 32} * 15 * 60 * 1000000;
+    const int64_t end_us = start_us + int64_t{25} * 60 * 1000000;
+    if (legacy) {
+      done->set_start_time(FormatClock(start_us, 7200));
+      done->set_end_time(FormatClock(end_us, 7200));
+    } else {
+      done->set_start_time_us(start_us);
+      done->set_end_time_us(end_us);
+      done->set_utc_offset_seconds(7200);
+    }
+  }
+  return history;
+}
+
+void BenchmarkDoneTimes() {
+  for (const bool legacy : {true, false}) {
+    const std::string prefix =
+        legacy ? "DoneTimes/string/" : "DoneTimes/int64/";
+    const TodayHistoryProto history = MakeHistory(legacy);
+    const std::string data = history.SerializeAsString();
+    ReportValue(prefix + "bytes", static_cast<double>(data.size()) / kRecords,
+                "bytes/record");
+
+    RunBenchmark(prefix + "Serialize", kRecords, [&] {
+      std::string out;
+      history.SerializeToString(&out);
+      DoNotOptimize(out);
+    });
+    RunBenchmark(prefix + "Parse", kRecords, [&] {
+      TodayHistoryProto parsed;
+      parsed.ParseFromString(data);
+      DoNotOptimize(parsed);
+    });
+  }
+
+  RunBenchmark("DoneTimes/UpgradeDoneTimes", 1, [] {
+    Done done;
+    done.set_start_time("09:15");
+    done.set_end_time("09:40");
+    UpgradeDoneTimes("2021-04-19", &done);
+    DoNotOptimize(done);
+  });
+  RunBenchmark("DoneTimes/FormatClock", 1, [] {
+    DoNotOptimize(FormatClock(kStartUs, 7200));
+  });
+}
+
+// A year of archived days, serialized and as columnar blocks. Durations are
+// whole minutes, as imported from todo.history.txt, or as measured by the
+// timer, which no unit of the blocks holds exactly.
+void BenchmarkHistoryBlock() {
+  constexpr int kDays = 365;
+  constexpr int kDonesPerDay = 24;
+  constexpr int64_t kMinuteUs = 60 * 1000000;
+  const int first = *ParseDay("2021-04-19");
+  for (const bool measured : {false, true}) {
+    std::vector<TodayHistoryProto> days(kDays);
+    for (int day = 0; day < kDays; ++day) {
+      days[day].set_day(FormatDay(first + day));
+      for (int i = 0; i < kDonesPerDay; ++i) {
+        Done *done = days[day].add_done();
+        const bool work = i % 2 == 0;
+        const int64_t start_us = kStartUs + day * 24 * 60 * kMinuteUs +
+                                 i * 15 * kMinuteUs + i * 37 % 1000;
+        const int64_t end_us =
+            start_us + (work ? 25 : 5) * kMinuteUs + i * 101 % 1000;
+        done->set_done_type(work ? Done::WORK : Done::BREAK);
+        done->set_start_time_us(start_us);
+        done->set_end_time_us(end_us);
+        done->set_utc_offset_seconds(7200);
+        done->set_duration_seconds(measured ? (end_us - start_us) * 1.0000013e-6
+                                            : (work ? 25 : 5) * 60);
+        if (work) {
+          const int todo = (day * 3 + i / 4) % 12;
+          done->set_todo("Todo number " + std::to_string(todo));
+          done->set_todo_id(todo + 1);
+        }
+      }
+    }
+
+    std::vector<std::string> protos;
+    std::vector<std::string> blocks;
+    size_t proto_bytes = 0;
+    size_t block_bytes = 0;
+    for (const TodayHistoryProto &history : days) {
+      protos.push_back(history.SerializeAsString());
+      proto_bytes += protos.back().size();
+      EncodeHistoryBlock(history, &blocks.emplace_back());
+      block_bytes += blocks.back().size();
+    }
+    constexpr int kRecords = kDays * kDonesPerDay;
+    const std::string prefix = std::string("HistoryBlock/365d/") +
+                               (measured ? "measured" : "whole_minutes");
+    ReportValue(prefix + "/proto/bytes",
+                static_cast<double>(proto_bytes) / kRecords, "bytes/record");
+    ReportValue(prefix + "/block/bytes",
+                static_cast<double>(block_bytes) / kRecords, "bytes/record");
+
+    RunBenchmark(prefix + "/proto/Parse", kRecords, [&] {
+      TodayHistoryProto history;
+      for (const std::string &proto : protos) {
+        history.ParseFromString(proto);
+        DoNotOptimize(history);
+      }
+    });
+    RunBenchmark(prefix + "/block/Decode", kRecords, [&] {
+      TodayHistoryProto history;
+      for (const std::string &block : blocks) {
+        DecodeHistoryBlock(block, &history);
+        DoNotOptimize(history);
+      }
+    });
+    RunBenchmark(prefix + "/block/Encode", kRecords, [&] {
+      std::string block;
+      for (const TodayHistoryProto &history : days) {
+        EncodeHistoryBlock(history, &block);
+        DoNotOptimize(block);
+      }
+    });
+  }
+}
+
+void BenchmarkHistoryStats() {
+  constexpr int kDays = 3 * 365;
+  constexpr int kDonesPerDay = 24;
+  constexpr int kRecords = kDays * kDonesPerDay;
+  const int first = *ParseDay("2021-04-19");
+  std::vector<TodayHistoryProto> days(kDays);
+  HistoryColumns columns;
+  for (int day = 0; day < kDays; ++day) {
+    days[day].set_day(FormatDay(first + day));
+    for (int i = 0; i < kDonesPerDay; ++i) {
+      Done *done = days[day].add_done();
+      const bool work = (i * 7 + day) % 5 != 0;
+      done->set_done_type(work ? Done::WORK : Done::BREAK);
+      done->set_duration_seconds((work ? 25 * 60 : 5 * 60) +
+                                 (i * 37 + day * 11) % 240 - 120);
+    }
+    columns.Append(days[day]);
+  }
+
+  RunBenchmark("HistoryStats/3y/Aggregate/proto", kRecords, [&] {
+    TypeStats stats;
+    for (const TodayHistoryProto &history : days) {
+      for (const Done &done : history.done()) {
+        if (done.done_type() != Done::WORK) {
+          continue;
+        }
+        ++stats.count;
+        stats.seconds += done.duration_seconds();
+        stats.overtime_seconds +=
+            std::max(done.duration_seconds() - kWorkPhaseSeconds, 0.0);
+        stats.min_seconds =
+            std::min(stats.min_seconds, done.duration_seconds());
+        stats.max_seconds =
+            std::max(stats.max_seconds, done.duration_seconds());
+      }
+    }
+    DoNotOptimize(stats);
+  });
+  for (const SimdLevel level : {SimdLevel::kScalar, SimdLevel::kAvx2}) {
+    if (level > DetectSimdLevel()) {
+      continue;
+    }
+    const std::string name = level == SimdLevel::kAvx2 ? "avx2" : "scalar";
+    RunBenchmark("HistoryStats/3y/Aggregate/" + name, kRecords, [&] {
+      DoNotOptimize(Aggregate(columns, Done::WORK, kWorkPhaseSeconds, level));
+    });
+  }
+
+  RunBenchmark("HistoryStats/3y/AggregateByDay/proto", kRecords, [&] {
+    std::map<int, TypeStats> stats;
+    for (const TodayHistoryProto &history : days) {
+      const int day = *ParseDay(history.day());
+      for (const Done &done : history.done()) {
+        if (done.done_type() != Done::WORK) {
+          continue;
+        }
+        TypeStats &day_stats = stats[day];
+        ++day_stats.count;
+        day_stats.seconds += done.duration_seconds();
+        day_stats.overtime_seconds +=
+            std::max(done.duration_seconds() - kWorkPhaseSeconds, 0.0);
+        day_stats.min_seconds =
+            std::min(day_stats.min_seconds, done.duration_seconds());
+        day_stats.max_seconds =
+            std::max(day_stats.max_seconds, done.duration_seconds());
+      }
+    }
+    DoNotOptimize(stats);
+  });
+  for (const SimdLevel level : {SimdLevel::kScalar, SimdLevel::kAvx2}) {
+    if (level > DetectSimdLevel()) {
+      continue;
+    }
+    const std::string name = level == SimdLevel::kAvx2 ? "avx2" : "scalar";
+    RunBenchmark("HistoryStats/3y/AggregateByDay/" + name, kRecords, [&] {
+      DoNotOptimize(
+          AggregateByDay(columns, Done::WORK, kWorkPhaseSeconds, level));
+    });
+  }
+}
+
+StateProto MakeState(int todos, int dones) {
+  StateProto proto;
+  for (int i = 0; i < todos; ++i) {
+    TodoProto *todo = proto.add_todo_item();
+    todo->set_text("Todo number " + std::to_string(i));
+    todo->set_done(i % 3 == 0);
+  }
+  TodayHistoryProto *history = proto.mutable_history();
+  history->set_day("2021-04-19");
+  for (int i = 0; i < dones; ++i) {
+    Done *done = history->add_done();
+    done->set_done_type(i % 2 == 0 ? Done::WORK : Done::BREAK);
+    done->set_todo("Todo number " + std::to_string(i % todos));
+    done->set_duration_seconds(i % 2 == 0 ? 25 * 60 : 5 * 60);
+    done->set_start_time_us(kStartUs + int64_t{i} * 15 * 60 * 1000000);
+    done->set_end_time_us(done->start_time_us() + int64_t{25} * 60 * 1000000);
+  }
+  return proto;
+}
+
+void BenchmarkState() {
+  constexpr int kTodos = 1000;
+  constexpr int kDones = 10000;
+  const StateProto proto = MakeState(kTodos, kDones);
+  const State state(proto);
+
+  RunBenchmark("State/FromProto/1k_todos/10k_done", 1, [&] {
+    State constructed(proto);
+    DoNotOptimize(constructed);
+  });
+  RunBenchmark("State/ToProto/1k_todos/10k_done", 1,
+               [&] { DoNotOptimize(state.ToProto()); });
+
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.bp";
+  RunBenchmark("Storage/SaveLoadState/1k_todos/10k_done", 1, [&] {
+    SaveState(path, state.ToProto());
+    DoNotOptimize(LoadState(path));
+  });
+  std::remove(path.c_str());
+}
+
+// A state file's round trip: loading it into a State and saving it again.
+void BenchmarkLoadSave() {
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.bp";
+  SaveState(path, State(MakeState(1000, 100000)).ToProto());
+  RunBenchmark("Storage/LoadState/1k_todos/100k_done", 1, [&] {
+    State state(LoadState(path));
+    DoNotOptimize(state);
+  });
+  const State state(LoadState(path));
+  RunBenchmark("Storage/SaveState/1k_todos/100k_done", 1,
+               [&] { SaveState(path, state); });
+  std::remove(path.c_str());
+}
+
+// Loads a state file and draws the first frame, parsing all of it, only
+// what the first frame needs, or mapping the flat file. States are destroyed
+// outside the timing, as the lazy one waits for its history there.
+void BenchmarkStartup() {
+  constexpr int kRuns = 50;
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.bp";
+  const std::string flat_path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.flat";
+
+  for (const int dones : {10000, 100000}) {
+    const State saved(MakeState(1000, dones));
+    SaveState(path, saved);
+    SaveFlatState(flat_path, saved);
+    for (const std::string mode : {"eager", "lazy", "flat"}) {
+      std::chrono::duration<double, std::milli> total{0};
+      for (int i = 0; i < kRuns; ++i) {
+        const auto start = std::chrono::steady_clock::now();
+        std::unique_ptr<State> state;
+        if (mode == "flat") {
+          state = std::make_unique<State>(FlatState::Open(flat_path));
+        } else if (mode == "lazy") {
+          PartialState partial = LoadStatePartial(path);
+          state = std::make_unique<State>(std::move(partial.proto),
+                                          std::move(partial.history_bytes));
+        } else {
+          state = std::make_unique<State>(LoadState(path));
+        }
+        MemoryScreen screen(40, 120);
+        Todo todo(*state);
+        DrawToday(screen, *state);
+        todo.Draw(screen);
+        screen.Present();
+        DoNotOptimize(screen);
+        total += std::chrono::steady_clock::now() - start;
+      }
+      ReportValue("Startup/FirstFrame/1k_todos/" +
+                      std::to_string(dones / 1000) + "k_done/" + mode,
+                  total.count() / kRuns, "ms");
+    }
+  }
+
+  // Reading the history from the mapping, once it is needed.
+  const State state(FlatState::Open(flat_path));
+  RunBenchmark("FlatState/History/1k_todos/100k_done", 1, [&] {
+    State copy(state);
+    DoNotOptimize(copy.history());
+  });
+  RunBenchmark("Storage/SaveFlatState/1k_todos/100k_done", 1,
+               [&] { SaveFlatState(flat_path, state); });
+  std::remove(path.c_str());
+  std::remove(flat_path.c_str());
+}
+
+void BenchmarkTodoList() {
+  constexpr int kTodos = 100000;
+  RunBenchmark("TodoList/PushFront/100k", kTodos, [] {
+    TodoList list;
+    for (uint64_t id = 1; id <= kTodos; ++id) {
+      list.PushFront({.id = id, .text = "Todo"});
+    }
+    DoNotOptimize(list);
+  });
+  RunBenchmark("State/AddTodoFront/100k", kTodos, [] {
+    State state{StateProto()};
+    for (int i = 0; i < kTodos; ++i) {
+      state.AddTodoFront("Todo");
+    }
+    DoNotOptimize(state);
+  });
+
+  TodoList list;
+  for (uint64_t id = 1; id <= kTodos; ++id) {
+    if (id % 2 == 0) {
+      list.PushFront({.id = id, .text = "Todo"});
+    } else {
+      list.PushBack({.id = id, .text = "Todo"});
+    }
+  }
+  size_t position = 0;
+  RunBenchmark("TodoList/operator[]/100k", 1, [&] {
+    position = (position + 7919) % list.size();
+    DoNotOptimize(list[position]);
+  });
+  uint64_t id = 0;
+  RunBenchmark("TodoList/PositionOf/100k", 1, [&] {
+    id = id % kTodos + 1;
+    DoNotOptimize(list.PositionOf(id));
+  });
+  RunBenchmark("TodoList/EraseMiddle+PushBack/100k", 1, [&] {
+    const uint64_t new_id = list[list.size() / 2].id;
+    list.Erase(list.size() / 2);
+    list.PushBack({.id = new_id, .text = "Todo"});
+  });
+}
+
+// Summarizes three years of archived history with growing thread counts.
+void BenchmarkReport() {
+  constexpr int kDays = 3 * 365;
+  constexpr int kDonesPerDay = 24;
+  const int first = *ParseDay("2021-04-19");
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.archive";
+  std::filesystem::remove(path);
+  std::filesystem::remove(path + ".index");
+  {
+    HistoryArchive archive(path);
+    StateProto proto = MakeState(50, kDonesPerDay);
+    const std::vector<Done> dones(proto.history().done().begin(),
+                                  proto.history().done().end());
+    for (int day = first; day < first + kDays; ++day) {
+      archive.Put(FormatDay(day), dones);
+    }
+  }
+  const HistoryArchive archive(path);
+  const double megabytes =
+      static_cast<double>(std::filesystem::file_size(path)) / (1 << 20);
+
+  for (const int threads : {1, 2, 4, 8}) {
+    const std::string name = "Report/3y/threads:" + std::to_string(threads);
+    RunBenchmark(name, kDays * kDonesPerDay, [&] {
+      DoNotOptimize(BuildReport(archive, first, first + kDays - 1, threads));
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    DoNotOptimize(BuildReport(archive, first, first + kDays - 1, threads));
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    ReportValue(name + "/throughput", megabytes / elapsed.count(), "MB/s");
+  }
+  std::filesystem::remove(path);
+  std::filesystem::remove(path + ".index");
+}
+
+// Parses years of todo.txt and todo.history.txt logs, three sessions a day.
+void BenchmarkImport() {
+  constexpr int kDays = 5 * 365;
+  const int first = *ParseDay("2021-04-19");
+  std::string todo_txt;
+  std::string history_txt;
+  for (int day = first; day < first + kDays; ++day) {
+    for (int session = 1; session <= 3; ++session) {
+      todo_txt += "\n" + FormatDay(day) + "\n";
+      for (int i = 0; i < 20; ++i) {
+        todo_txt += i < session ? " x " : "   ";
+        todo_txt += "Todo number " + std::to_string(i) + "\n";
+      }
+      history_txt += "\n" + FormatDay(day) + "\n";
+      for (int i = 0; i < 4 * session; ++i) {
+        history_txt += "  09:15 09:40 25m Todo number " + std::to_string(i) +
+                       "\n";
+      }
+    }
+  }
+  const double megabytes =
+      static_cast<double>(todo_txt.size() + history_txt.size()) / (1 << 20);
+  ReportValue("Import/5y/size", megabytes, "MB");
+
+  for (const int threads : {1, 2, 4, 8}) {
+    const std::string name = "Import/5y/threads:" + std::to_string(threads);
+    RunBenchmark(name, 1, [&] {
+      DoNotOptimize(ParseTodoLog(todo_txt, threads));
+      DoNotOptimize(ParseHistoryLog(history_txt, threads));
+    });
+
+    const auto start = std::chrono::steady_clock::now();
+    DoNotOptimize(ParseTodoLog(todo_txt, threads));
+    DoNotOptimize(ParseHistoryLog(history_txt, threads));
+    const std::chrono::duration<double> elapsed =
+        std::chrono::steady_clock::now() - start;
+    ReportValue(name + "/throughput", megabytes / elapsed.count(), "MB/s");
+  }
+}
+
+// Types a query one character at a time, as in the todo search mode.
+void BenchmarkSearch() {
+  constexpr int kTodos = 100000;
+  const char *const kWords[] = {"write", "review", "report", "fix", "deploy",
+                                "email", "budget", "planning", "bug", "design"};
+  StateProto proto;
+  for (int i = 0; i < kTodos; ++i) {
+    proto.add_todo_item()->set_text(std::string(kWords[i % 10]) + " " +
+                                    kWords[i / 10 % 10] + " item " +
+                                    std::to_string(i));
+  }
+  State state(proto);
+  std::unique_ptr<TodoSearch> search;
+  RunBenchmark("TodoSearch/Build/100k", kTodos,
+               [&] { search = std::make_unique<TodoSearch>(state); });
+  state.AddObserver(search.get());
+
+  for (const std::string query : {"report", "review 4711", "e"}) {
+    RunBenchmark("TodoSearch/Keystroke/100k/" + query, query.size(), [&] {
+      for (size_t length = 1; length <= query.size(); ++length) {
+        DoNotOptimize(search->Search(query.substr(0, length)));
+      }
+    });
+  }
+
+  RunBenchmark("TodoSearch/AddTodoFront+Delete/100k", 1, [&] {
+    state.AddTodoFront("review the quarterly report");
+    state.DeleteTodo(0);
+  });
+}
+
+// Draws into in-memory screens, so no terminal is needed. Each frame is
+// erased, redrawn and presented, and the estimated terminal output of a frame
+// is reported.
+void BenchmarkDraw() {
+  constexpr int kRows = 40;
+  constexpr int kCols = 120;
+
+  for (const int todos : {1000, 10000, 100000}) {
+    State state(MakeState(todos, 0));
+    Todo todo(state);
+    MemoryScreen screen(kRows, kCols);
+    RunBenchmark("Todo::Draw/" + std::to_string(todos), 1, [&] {
+      screen.Erase();
+      todo.Draw(screen);
+      screen.Present();
+    });
+    todo.Down();
+    screen.Erase();
+    todo.Draw(screen);
+    screen.Present();
+    ReportValue("Todo::Draw/" + std::to_string(todos) + "/cursor_down",
+                screen.last_frame_bytes(), "bytes/frame");
+  }
+
+  for (const int dones : {1000, 5000}) {
+    const State state(MakeState(10, dones));
+    MemoryScreen screen(1, kCols);
+    RunBenchmark("DrawToday/" + std::to_string(dones), 1, [&] {
+      screen.Erase();
+      DrawToday(screen, state);
+      screen.Present();
+    });
+  }
+
+  State state(MakeState(10, 0));
+  Todo todo(state);
+  Pomodoro pomodoro(state, todo);
+  pomodoro.Start();
+  MemoryScreen screen(1, kCols);
+  RunBenchmark("Pomodoro::Draw", 1, [&] {
+    screen.Erase();
+    pomodoro.Draw(screen, pomodoro.GetView(kCols));
+    screen.Present();
+  });
+  ReportValue("Pomodoro::Draw/first_frame", screen.total_bytes(), "bytes");
+}
+
+// Attaches a client to a daemon in the same thread, until the client drew its
+// first frame: connecting, the snapshot, parsing it and drawing.
+void BenchmarkAttach() {
+  constexpr int kRows = 40;
+  constexpr int kCols = 120;
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.socket";
+
+  for (const int todos : {100, 10000, 100000}) {
+    State state(MakeState(todos, 20));
+    Todo daemon_todo(state);
+    Pomodoro daemon_pomodoro(state, daemon_todo);
+    daemon_pomodoro.Start();
+    EventLoop loop;
+    Daemon daemon(ListenUnix(path), state, daemon_todo, daemon_pomodoro, loop);
+    state.AddObserver(&daemon);
+
+    RunBenchmark("Daemon/AttachToFirstFrame/" + std::to_string(todos), 1, [&] {
+      std::unique_ptr<DaemonClient> client = DaemonClient::Connect(path);
+      DaemonMessage snapshot;
+      while (!client->Next(&snapshot)) {
+        daemon.Handle(loop.Wait(EventLoop::Clock::now()));
+        client->Receive();
+      }
+      State client_state(snapshot.state());
+      Todo todo(client_state);
+      Pomodoro pomodoro(client_state, todo);
+      pomodoro.Restore(snapshot.status());
+      MemoryScreen screen(kRows, kCols);
+      pomodoro.Draw(screen, pomodoro.GetView(kCols));
+      DrawToday(screen, client_state);
+      todo.Draw(screen);
+      screen.Present();
+      DoNotOptimize(screen);
+      client.reset();
+      // Let the daemon notice the client is gone.
+      daemon.Handle(loop.Wait(EventLoop::Clock::now()));
+    });
+  }
+  std::filesystem::remove(path);
+}
+
+// Publishes and reads the status page, as cprd and cprd_status do.
+void BenchmarkStatusPage() {
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.status";
+  State state(MakeState(10, 0));
+  Todo todo(state);
+  Pomodoro pomodoro(state, todo);
+  pomodoro.Start();
+  {
+    StatusPageWriter writer(path);
+    const StatusPageReader reader(path);
+    RunBenchmark("StatusPage/Publish/unchanged", 1, [&] {
+      writer.Publish(pomodoro.Status(), todo.CurrentTodoText());
+    });
+    StatusPageData data;
+    RunBenchmark("StatusPage/Read", 1, [&] {
+      reader.Read(&data);
+      DoNotOptimize(data);
+    });
+  }
+  std::filesystem::remove(path);
+}
+
+// Runs a year of scripted days through the Pomodoro state machine on a
+// simulated clock.
+void BenchmarkSimulation() {
+  constexpr int kDays = 7 * 52;
+  SimulationStats stats;
+  RunBenchmark("Simulation/year", 1, [&] {
+    stats = Simulate(kDefaultDayScript, kDays);
+    DoNotOptimize(stats);
+  });
+  ReportValue("Simulation/year/steps", stats.steps, "steps");
+  ReportValue("Simulation/year/wrong_breaks", stats.wrong_breaks, "breaks");
+}
+
+// One tick of the event loop with many pending timers, e.g. reminders, where
+// one timer expires per tick: the wheel against checking every timer.
+void BenchmarkTimers() {
+  constexpr auto kTick = std::chrono::milliseconds(1);
+  for (const int timers : {100, 10000, 1000000}) {
+    const TimerWheel::TimePoint start{};
+    TimerWheel wheel(start);
+    std::vector<TimerWheel::TimePoint> deadlines;
+    for (int i = 0; i < timers; ++i) {
+      deadlines.push_back(start + (i + 1) * kTick);
+      wheel.Schedule(deadlines.back(), [] {});
+    }
+
+    TimerWheel::TimePoint now = start;
+    int64_t expired = 0;
+    RunBenchmark("Timers/wheel/" + std::to_string(timers), 1, [&] {
+      now += kTick;
+      expired += wheel.Advance(now);
+      // Keep the number of timers constant.
+      wheel.Schedule(now + timers * kTick, [] {});
+    });
+    DoNotOptimize(expired);
+
+    now = start;
+    RunBenchmark("Timers/polling/" + std::to_string(timers), 1, [&] {
+      now += kTick;
+      for (TimerWheel::TimePoint &deadline : deadlines) {
+        if (deadline <= now) {
+          ++expired;
+          deadline += timers * kTick;
+        }
+      }
+    });
+    DoNotOptimize(expired);
+  }
+}
+
+// CPU time of the whole process, server and load generator alike.
+double CpuSeconds() {
+  rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  const auto seconds = [](const timeval &time) {
+    return time.tv_sec + time.tv_usec / 1e6;
+  };
+  return seconds(usage.ru_utime) + seconds(usage.ru_stime);
+}
+
+// 10k simulated users against a team server in the same process.
+void BenchmarkTeamServer() {
+  const std::filesystem::path directory =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark_team";
+  const std::string path =
+      std::filesystem::temp_directory_path() / "pomodoro_benchmark.team";
+  const int shards = std::max(1u, std::thread::hardware_concurrency());
+  const int stop_fd = eventfd(0, EFD_CLOEXEC);
+  std::optional<TeamLoadResult> result;
+  const double cpu_start = CpuSeconds();
+  {
+    TeamServer server(ListenUnix(path), directory, shards);
+    std::thread thread([&] { server.Run(stop_fd); });
+    result = RunTeamLoad({.socket_path = path,
+                          .users = 10000,
+                          .duration = std::chrono::seconds(2)});
+    const uint64_t one = 1;
+    static_cast<void>(write(stop_fd, &one, sizeof one));
+    thread.join();
+  }
+  const double cpu_seconds = CpuSeconds() - cpu_start;
+  close(stop_fd);
+  std::filesystem::remove(path);
+  std::filesystem::remove_all(directory);
+  if (!result) {
+    return;
+  }
+  ReportValue("TeamServer/10k_users/throughput", result->CommandsPerSecond(),
+              "commands/s");
+  ReportValue("TeamServer/10k_users/per_cpu_second",
+              result->commands / cpu_seconds, "commands");
+  ReportValue("TeamServer/10k_users/p50", result->p50_us, "us");
+  ReportValue("TeamServer/10k_users/p99", result->p99_us, "us");
+}
+
+} // namespace
+
+int main() {
+  GOOGLE_PROTOBUF_VERIFY_VERSION;
+  BenchmarkDoneTimes();
+  BenchmarkHistoryBlock();
+  BenchmarkHistoryStats();
+  BenchmarkState();
+  BenchmarkLoadSave();
+  BenchmarkStartup();
+  BenchmarkTodoList();
+  BenchmarkSearch();
+  BenchmarkReport();
+  BenchmarkImport();
+  BenchmarkAttach();
+  BenchmarkStatusPage();
+  BenchmarkSimulation();
+  BenchmarkTimers();
+  BenchmarkTeamServer();
+  BenchmarkDraw();
+}
@@ -0,0 +1,138 @@
+#include "channel.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "google/protobuf/io/coded_stream.h"
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+
+// A client that lets this much output pile up is dropped.
+constexpr size_t kMaxQueuedBytes = 64 << 20;
+
+bool MakeAddress(const std::string &path, sockaddr_un *address) {
+  *address = {};
+  address->sun_family = AF_UNIX;
+  if (path.size() >= sizeof address->sun_path) {
+    return false;
+  }
+  std::memcpy(address->sun_path, path.c_str(), path.size() + 1);
+  return true;
+}
+
+} // namespace
+
+int ListenUnix(const std::string &path) {
+  sockaddr_un address;
+  if (!MakeAddress(path, &address)) {
+    return -1;
+  }
+  const int fd =
+      socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  unlink(path.c_str());
+  if (bind(fd, reinterpret_cast<const sockaddr *>(&address), sizeof address) !=
+          0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int ConnectUnix(const std::string &path) {
+  sockaddr_un address;
+  if (!MakeAddress(path, &address)) {
+    return -1;
+  }
+  const int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  // Connecting to a Unix socket does not wait for the peer to accept, so it
+  // is done blocking.
+  if (connect(fd, reinterpret_cast<const sockaddr *>(&address),
+              sizeof address) != 0 ||
+      fcntl(fd, F_SETFL, O_NONBLOCK) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+Channel::~Channel() { close(fd_); }
+
+bool Channel::Send(std::string_view payload) {
+  return Queue(payload) && Flush();
+}
+
+bool Channel::Queue(std::string_view payload) {
+  if (!has_output()) {
+    output_.clear();
+    output_pos_ = 0;
+  }
+  if (output_.size() - output_pos_ > kMaxQueuedBytes) {
+    return false;
+  }
+  uint8_t length[sizeof(uint32_t)];
+  CodedOutputStream::WriteLittleEndian32ToArray(payload.size(), length);
+  output_.append(reinterpret_cast<const char *>(length), sizeof length);
+  output_.append(payload);
+  return true;
+}
+
+bool Channel::Flush() {
+  while (has_output()) {
+    const ssize_t n = send(fd_, output_.data() + output_pos_,
+                           output_.size() - output_pos_, MSG_NOSIGNAL);
+    if (n < 0) {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+    output_pos_ += n;
+  }
+  return true;
+}
+
+bool Channel::Receive() {
+  // Drop what was parsed before the buffer grows.
+  input_.erase(0, input_pos_);
+  input_pos_ = 0;
+
+  char buffer[64 << 10];
+  while (true) {
+    const ssize_t n = read(fd_, buffer, sizeof buffer);
+    if (n > 0) {
+      input_.append(buffer, n);
+    } else if (n == 0) {
+      return false;
+    } else {
+      return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+    }
+  }
+}
+
+bool Channel::Next(google::protobuf::MessageLite *message) {
+  const size_t available = input_.size() - input_pos_;
+  if (corrupt_ || available < sizeof(uint32_t)) {
+    return false;
+  }
+  const uint8_t *data =
+      reinterpret_cast<const uint8_t *>(input_.data() + input_pos_);
+  uint32_t length;
+  CodedInputStream::ReadLittleEndian32FromArray(data, &length);
+  if (available - sizeof length < length) {
+    return false;
+  }
+  input_pos_ += sizeof length + length;
+  corrupt_ = !message->ParseFromArray(data + sizeof length, length);
+  return !corrupt_;
+}
@@ -0,0 +1,66 @@
+#ifndef POMODORO_CHANNEL_H_
+#define POMODORO_CHANNEL_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "google/protobuf/message_lite.h"
+
+// Listens on a Unix domain socket at `path`, replacing a stale socket file.
+// Returns the non-blocking listening fd, or -1 on errors.
+int ListenUnix(const std::string &path);
+// Connects to the Unix domain socket at `path`. Returns the non-blocking fd,
+// or -1 if nobody listens there.
+int ConnectUnix(const std::string &path);
+
+// Exchanges protobuf messages over a non-blocking stream socket. Each message
+// is framed by its little endian uint32 length. Neither sending nor receiving
+// blocks: output that the socket does not take is queued until Flush(), input
+// is buffered until a message is complete.
+class Channel {
+public:
+  // Takes ownership of `fd`.
+  explicit Channel(int fd) : fd_(fd) {}
+  ~Channel();
+  Channel(const Channel &) = delete;
+  Channel &operator=(const Channel &) = delete;
+
+  int fd() const { return fd_; }
+
+  // Queues a serialized message and writes what the socket takes. Returns
+  // false if the peer is gone or does not keep up with reading.
+  bool Send(std::string_view payload);
+  bool Send(const google::protobuf::MessageLite &message) {
+    return Send(message.SerializeAsString());
+  }
+  // Like Send(), but only queues the message until the next Flush(), e.g. to
+  // write many messages at once.
+  bool Queue(std::string_view payload);
+  // Writes queued output. Returns false if the peer is gone.
+  bool Flush();
+  bool has_output() const { return output_.size() > output_pos_; }
+
+  // Reads everything available. Returns false once the peer closed the
+  // connection.
+  bool Receive();
+  // Parses the next complete received message into `message`. Returns false
+  // if there is none, or if it did not parse.
+  bool Next(google::protobuf::MessageLite *message);
+  // True once a received message did not parse. Nothing after it can be
+  // trusted, so Next() returns false from then on and the peer should be
+  // dropped.
+  bool corrupt() const { return corrupt_; }
+
+private:
+  int fd_;
+  std::string output_;
+  // Bytes of output_ already written.
+  size_t output_pos_ = 0;
+  std::string input_;
+  // Bytes of input_ already parsed.
+  size_t input_pos_ = 0;
+  bool corrupt_ = false;
+};
+
+#endif // POMODORO_CHANNEL_H_
@@ -0,0 +1,33 @@
+#include "curses_screen.h"
+
+namespace {
+
+attr_t ToAttributes(Style style) {
+  attr_t attrs = 0;
+  if (style.attributes & Style::kBold) {
+    attrs |= WA_BOLD;
+  }
+  if (style.attributes & Style::kDim) {
+    attrs |= WA_DIM;
+  }
+  return attrs;
+}
+
+} // namespace
+
+void CursesScreen::Print(int y, int x, std::string_view text, Style style) {
+  if (wmove(window_, y, x) == ERR) {
+    return;
+  }
+  Append(text, style);
+}
+
+void CursesScreen::Append(std::string_view text, Style style) {
+  wattr_set(window_, ToAttributes(style), style.color, nullptr);
+  waddnstr(window_, text.data(), text.size());
+  wattr_set(window_, 0, 0, nullptr);
+}
+
+void CursesScreen::ChangeStyle(int y, int x, int n, Style style) {
+  mvwchgat(window_, y, x, n, ToAttributes(style), style.color, nullptr);
+}
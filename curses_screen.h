@@ -0,0 +1,45 @@
+#ifndef POMODORO_CURSES_SCREEN_H_
+#define POMODORO_CURSES_SCREEN_H_
+
+#include "ncurses.h"
+
+#include "screen.h"
+#include "trace.h"
+
+// A Screen backed by an ncurses window. Present() only stages the window;
+// call doupdate() once per frame to write all staged windows.
+class CursesScreen : public Screen {
+public:
+  struct Args {
+    int nlines;
+    int ncols;
+    int begin_y;
+    int begin_x;
+  };
+
+  explicit CursesScreen(Args args)
+      : window_(newwin(args.nlines, args.ncols, args.begin_y, args.begin_x)) {}
+  ~CursesScreen() override { delwin(window_); }
+  CursesScreen(const CursesScreen &) = delete;
+  CursesScreen &operator=(const CursesScreen &) = delete;
+
+  WINDOW *window() const { return window_; }
+
+  int rows() const override { return getmaxy(window_); }
+  int cols() const override { return getmaxx(window_); }
+
+  void Erase() override { werase(window_); }
+  void Print(int y, int x, std::string_view text, Style style) override;
+  void Append(std::string_view text, Style style) override;
+  void ChangeStyle(int y, int x, int n, Style style) override;
+  void Move(int y, int x) override { wmove(window_, y, x); }
+  void Present() override {
+    TRACE_SPAN("wnoutrefresh");
+    wnoutrefresh(window_);
+  }
+
+private:
+  WINDOW *window_;
+};
+
+#endif // POMODORO_CURSES_SCREEN_H_
@@ -0,0 +1,182 @@
+#include "daemon.h"
+
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+Daemon::Daemon(int listen_fd, State &state, Todo &todo, Pomodoro &pomodoro,
+               EventLoop &loop)
+    : listen_fd_(listen_fd), state_(state), todo_(todo), pomodoro_(pomodoro),
+      loop_(loop) {
+  loop_.Watch(listen_fd_);
+}
+
+Daemon::~Daemon() {
+  for (const auto &[fd, client] : clients_) {
+    loop_.Unwatch(fd);
+  }
+  loop_.Unwatch(listen_fd_);
+  close(listen_fd_);
+}
+
+void Daemon::Handle(const std::vector<int> &ready) {
+  TRACE_SPAN("Daemon::Handle");
+  for (const int fd : ready) {
+    if (fd == listen_fd_) {
+      Accept();
+      continue;
+    }
+    const auto it = clients_.find(fd);
+    if (it == clients_.end()) {
+      continue;
+    }
+    Channel &client = *it->second;
+    const bool ok = client.Receive();
+    ClientMessage message;
+    while (client.Next(&message)) {
+      HandleMessage(message);
+    }
+    Update(client, ok && !client.corrupt());
+  }
+  DropClosed();
+}
+
+std::optional<Timer::TimePoint> Daemon::Tick() {
+  TRACE_SPAN("Daemon::Tick");
+  if (pomodoro_.Tick()) {
+    BroadcastStatus();
+  }
+  DropClosed();
+  return pomodoro_.NextDeadline();
+}
+
+void Daemon::OnMutation(const Mutation &mutation) {
+  DaemonMessage message;
+  *message.mutable_mutation() = mutation;
+  Broadcast(message);
+}
+
+void Daemon::Accept() {
+  while (true) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    auto client = std::make_unique<Channel>(fd);
+    DaemonMessage message;
+    *message.mutable_state() = state_.ToProto();
+    *message.mutable_status() = pomodoro_.Status();
+    const bool ok = client->Send(message);
+    loop_.Watch(fd);
+    Channel &channel = *client;
+    clients_[fd] = std::move(client);
+    Update(channel, ok);
+  }
+}
+
+void Daemon::HandleMessage(const ClientMessage &message) {
+  if (message.has_current_todo_id()) {
+    todo_.Select(message.current_todo_id());
+  }
+  switch (message.request_case()) {
+  case ClientMessage::kMutation:
+    // Broadcast by OnMutation().
+    state_.Submit(message.mutation());
+    break;
+  case ClientMessage::kCommand:
+    switch (message.command()) {
+    case ClientMessage::START:
+      pomodoro_.Start();
+      break;
+    case ClientMessage::STOP:
+      pomodoro_.Stop();
+      break;
+    case ClientMessage::RESET:
+      pomodoro_.Reset();
+      break;
+    case ClientMessage::COMMAND_UNSPECIFIED:
+      break;
+    }
+    BroadcastStatus();
+    break;
+  case ClientMessage::REQUEST_NOT_SET:
+    break;
+  }
+}
+
+void Daemon::Broadcast(const DaemonMessage &message) {
+  // Serialized once for all clients.
+  const std::string payload = message.SerializeAsString();
+  for (const auto &[fd, client] : clients_) {
+    Update(*client, client->Send(payload));
+  }
+}
+
+void Daemon::BroadcastStatus() {
+  DaemonMessage message;
+  *message.mutable_status() = pomodoro_.Status();
+  Broadcast(message);
+}
+
+void Daemon::Update(Channel &client, bool ok) {
+  if (ok && client.Flush()) {
+    loop_.WatchWritable(client.fd(), client.has_output());
+  } else {
+    closed_.push_back(client.fd());
+  }
+}
+
+void Daemon::DropClosed() {
+  for (const int fd : closed_) {
+    if (clients_.contains(fd)) {
+      loop_.Unwatch(fd);
+      clients_.erase(fd);
+    }
+  }
+  closed_.clear();
+}
+
+std::unique_ptr<DaemonClient> DaemonClient::Connect(const std::string &path) {
+  const int fd = ConnectUnix(path);
+  if (fd < 0) {
+    return nullptr;
+  }
+  return std::unique_ptr<DaemonClient>(new DaemonClient(fd));
+}
+
+std::optional<DaemonMessage>
+DaemonClient::WaitForMessage(std::chrono::milliseconds timeout) {
+  const auto deadline = std::chrono::steady_clock::now() + timeout;
+  DaemonMessage message;
+  while (!channel_.Next(&message)) {
+    if (channel_.corrupt()) {
+      return std::nullopt;
+    }
+    const auto remaining =
+        std::chrono::duration_cast<std::chrono::milliseconds>(
+            deadline - std::chrono::steady_clock::now());
+    pollfd fd = {.fd = channel_.fd(), .events = POLLIN, .revents = 0};
+    if (remaining.count() <= 0 || poll(&fd, 1, remaining.count()) <= 0 ||
+        !channel_.Receive()) {
+      return std::nullopt;
+    }
+  }
+  return message;
+}
+
+void DaemonClient::Send(ClientMessage::Command command,
+                        uint64_t current_todo_id) {
+  ClientMessage message;
+  message.set_current_todo_id(current_todo_id);
+  message.set_command(command);
+  channel_.Send(message);
+}
+
+void DaemonClient::OnMutation(const Mutation &mutation) {
+  ClientMessage message;
+  *message.mutable_mutation() = mutation;
+  channel_.Send(message);
+}
@@ -0,0 +1,100 @@
+#ifndef POMODORO_DAEMON_H_
+#define POMODORO_DAEMON_H_
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "state.h"
+#include "state.pb.h"
+#include "time_utils.h"
+#include "ui.h"
+
+// Owns the state and the pomodoro timer on behalf of any number of cprd
+// clients, so closing a terminal does not stop the timer.
+//
+// Clients attach on a Unix socket and first get a DaemonMessage with the
+// whole state and the timer. After that, every change to the state and the
+// timer is pushed to all clients as it happens. Clients send the changes they
+// want to make as ClientMessages.
+class Daemon : public State::Observer {
+public:
+  // Serves clients connecting to `listen_fd`, which it takes ownership of.
+  // Finished work is booked on `todo`'s selection, which follows the client
+  // that sent a command. Add the daemon as an observer of `state`.
+  Daemon(int listen_fd, State &state, Todo &todo, Pomodoro &pomodoro,
+         EventLoop &loop);
+  ~Daemon() override;
+  Daemon(const Daemon &) = delete;
+  Daemon &operator=(const Daemon &) = delete;
+
+  // Accepts clients and serves the ones in `ready`, as returned by
+  // EventLoop::Wait().
+  void Handle(const std::vector<int> &ready);
+  // Runs the pomodoro's timers, e.g. lets it ring. Returns when to call it
+  // again.
+  std::optional<Timer::TimePoint> Tick();
+
+  void OnMutation(const Mutation &mutation) override;
+
+  int clients() const { return clients_.size(); }
+
+private:
+  void Accept();
+  void HandleMessage(const ClientMessage &message);
+  void Broadcast(const DaemonMessage &message);
+  void BroadcastStatus();
+  // Flushes output and adjusts the writability watch. Marks the client as
+  // closed if it is gone or `ok` is false, because a previous operation
+  // found it gone.
+  void Update(Channel &client, bool ok);
+  // Drops the clients marked as closed. They are kept until then, because
+  // callers up the stack may still use them.
+  void DropClosed();
+
+  int listen_fd_;
+  State &state_;
+  Todo &todo_;
+  Pomodoro &pomodoro_;
+  EventLoop &loop_;
+  std::unordered_map<int, std::unique_ptr<Channel>> clients_;
+  std::vector<int> closed_;
+};
+
+// The connection of a cprd UI to the daemon. Add it as the remote of the
+// client's State, so that changes made in the UI are sent to the daemon
+// instead of being applied. They come back in the daemon's broadcast.
+class DaemonClient : public State::Observer {
+public:
+  // Connects to the daemon at `path`. Returns nullptr if none is running.
+  static std::unique_ptr<DaemonClient> Connect(const std::string &path);
+
+  int fd() const { return channel_.fd(); }
+
+  // Waits up to `timeout` for the next message from the daemon.
+  std::optional<DaemonMessage> WaitForMessage(std::chrono::milliseconds timeout);
+  // Reads what the daemon sent, without blocking. Returns false once the
+  // daemon is gone.
+  bool Receive() { return channel_.Receive(); }
+  bool Next(DaemonMessage *message) { return channel_.Next(message); }
+  // True once the daemon sent something that did not parse.
+  bool corrupt() const { return channel_.corrupt(); }
+
+  // Asks the daemon to start, stop or reset the pomodoro. Work is booked on
+  // the todo with `current_todo_id`.
+  void Send(ClientMessage::Command command, uint64_t current_todo_id);
+
+  void OnMutation(const Mutation &mutation) override;
+
+private:
+  explicit DaemonClient(int fd) : channel_(fd) {}
+
+  Channel channel_;
+};
+
+#endif // POMODORO_DAEMON_H_
@@ -0,0 +1,104 @@
+#include "event_loop.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <unistd.h>
+
+#include "trace.h"
+
+EventLoop::EventLoop()
+    : epoll_fd_(epoll_create1(EPOLL_CLOEXEC)),
+      timer_fd_(timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC)) {
+  if (epoll_fd_ < 0 || timer_fd_ < 0) {
+    perror("Could not set up event loop");
+    std::exit(1);
+  }
+  Watch(timer_fd_);
+}
+
+EventLoop::~EventLoop() {
+  close(timer_fd_);
+  close(epoll_fd_);
+}
+
+void EventLoop::Watch(int fd) {
+  epoll_event event = {};
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+}
+
+void EventLoop::WatchWritable(int fd, bool writable) {
+  epoll_event event = {};
+  event.events = writable ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.fd = fd;
+  epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+}
+
+void EventLoop::Unwatch(int fd) {
+  epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+}
+
+void EventLoop::ArmTimer(std::optional<TimePoint> deadline) {
+  // An all-zero it_value disarms the timer.
+  itimerspec spec = {};
+  if (deadline) {
+    const auto since_epoch = deadline->time_since_epoch();
+    const auto seconds =
+        std::chrono::duration_cast<std::chrono::seconds>(since_epoch);
+    spec.it_value.tv_sec = seconds.count();
+    spec.it_value.tv_nsec =
+        std::chrono::duration_cast<std::chrono::nanoseconds>(since_epoch -
+                                                             seconds)
+            .count();
+    if (spec.it_value.tv_sec <= 0 && spec.it_value.tv_nsec <= 0) {
+      // Already due, but zero would disarm.
+      spec.it_value.tv_nsec = 1;
+    }
+  }
+  timerfd_settime(timer_fd_, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+std::vector<int> EventLoop::Wait(std::optional<TimePoint> deadline) {
+  TRACE_SPAN("EventLoop::Wait");
+  ArmTimer(deadline);
+
+  constexpr int kMaxEvents = 8;
+  epoll_event events[kMaxEvents];
+  const int n = epoll_wait(epoll_fd_, events, kMaxEvents, /*timeout=*/-1);
+
+  const TimePoint now = Clock::now();
+  ++wakeups_;
+  recent_wakeups_.push_back(now);
+  while (now - recent_wakeups_.front() > std::chrono::minutes(1)) {
+    recent_wakeups_.pop_front();
+  }
+
+  std::vector<int> ready;
+  // n < 0 with EINTR happens on signals like SIGWINCH, which ncurses turns
+  // into KEY_RESIZE.
+  for (int i = 0; i < n; ++i) {
+    if (events[i].data.fd == timer_fd_) {
+      uint64_t expirations;
+      static_cast<void>(read(timer_fd_, &expirations, sizeof expirations));
+    } else {
+      ready.push_back(events[i].data.fd);
+    }
+  }
+  return ready;
+}
+
+double EventLoop::WakeupsPerMinute() const {
+  const std::chrono::duration<double, std::ratio<60>> running =
+      Clock::now() - created_;
+  if (running.count() >= 1) {
+    return recent_wakeups_.size();
+  }
+  if (running.count() <= 0) {
+    return 0;
+  }
+  return recent_wakeups_.size() / running.count();
+}
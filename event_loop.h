@@ -0,0 +1,49 @@
+#ifndef POMODORO_EVENT_LOOP_H_
+#define POMODORO_EVENT_LOOP_H_
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <optional>
+#include <vector>
+
+// Sleeps until one of the watched file descriptors becomes readable or a
+// deadline passes, using epoll and a timerfd. Replaces polling the terminal in
+// a fixed interval.
+class EventLoop {
+public:
+  using Clock = std::chrono::steady_clock;
+  using TimePoint = std::chrono::time_point<Clock>;
+
+  EventLoop();
+  ~EventLoop();
+  EventLoop(const EventLoop &) = delete;
+  EventLoop &operator=(const EventLoop &) = delete;
+
+  // Wake up when `fd` is readable.
+  void Watch(int fd);
+  void Unwatch(int fd);
+  // Also wake up when the watched `fd` is writable, e.g. while output is
+  // queued for it.
+  void WatchWritable(int fd, bool writable);
+
+  // Blocks until a watched fd is readable, `deadline` has passed or a signal
+  // arrived. Without a deadline, only input or a signal wakes the loop up.
+  // Returns the ready fds.
+  std::vector<int> Wait(std::optional<TimePoint> deadline);
+
+  int64_t wakeups() const { return wakeups_; }
+  // Wakeups during the last minute, extrapolated if the loop runs shorter.
+  double WakeupsPerMinute() const;
+
+private:
+  void ArmTimer(std::optional<TimePoint> deadline);
+
+  int epoll_fd_;
+  int timer_fd_;
+  int64_t wakeups_ = 0;
+  TimePoint created_ = Clock::now();
+  std::deque<TimePoint> recent_wakeups_;
+};
+
+#endif // POMODORO_EVENT_LOOP_H_
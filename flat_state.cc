@@ -0,0 +1,120 @@
+#include "flat_state.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+// Whether `count` elements of `element_size` bytes at `section.offset` lie
+// within a file of `size` bytes, aligned.
+bool IsValid(const FlatSection &section, size_t element_size, size_t size) {
+  return section.offset % kFlatAlignment == 0 && section.offset <= size &&
+         section.count <= (size - section.offset) / element_size;
+}
+
+template <typename T>
+std::span<const T> Section(const char *data, const FlatSection &section) {
+  return {reinterpret_cast<const T *>(data + section.offset), section.count};
+}
+
+} // namespace
+
+std::shared_ptr<const FlatState> FlatState::Open(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return nullptr;
+  }
+  struct stat st;
+  void *data = MAP_FAILED;
+  if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(FlatHeader))) {
+    data = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  }
+  close(fd);
+  if (data == MAP_FAILED) {
+    return nullptr;
+  }
+  const size_t size = st.st_size;
+  const auto &header = *static_cast<const FlatHeader *>(data);
+  if (header.magic != FlatHeader::kMagic ||
+      header.version != FlatHeader::kVersion ||
+      !IsValid(header.todos, sizeof(FlatTodo), size) ||
+      !IsValid(header.phases, sizeof(FlatPhase), size) ||
+      !IsValid(header.dones, sizeof(FlatDone), size) ||
+      header.strings.offset > size ||
+      header.strings.count > size - header.strings.offset) {
+    munmap(data, size);
+    return nullptr;
+  }
+  // The records are read in no particular order.
+  madvise(data, size, MADV_RANDOM);
+  return std::shared_ptr<const FlatState>(
+      new FlatState(static_cast<const char *>(data), size));
+}
+
+FlatState::FlatState(const char *data, size_t size)
+    : data_(data), size_(size),
+      todos_(Section<FlatTodo>(data, header().todos)),
+      phases_(Section<FlatPhase>(data, header().phases)),
+      dones_(Section<FlatDone>(data, header().dones)),
+      strings_(data + header().strings.offset, header().strings.count) {}
+
+FlatState::~FlatState() { munmap(const_cast<char *>(data_), size_); }
+
+FlatState::Todo FlatState::todo(int index) const {
+  const FlatTodo &todo = todos_[index];
+  return {.id = todo.id, .done = todo.done != 0, .text = String(todo.text)};
+}
+
+std::optional<PomodoroStatus> FlatState::pomodoro() const {
+  const std::string_view bytes = String(header().pomodoro);
+  PomodoroStatus status;
+  if (bytes.empty() || !status.ParseFromArray(bytes.data(), bytes.size())) {
+    return std::nullopt;
+  }
+  return status;
+}
+
+Done FlatState::done(int index) const {
+  const FlatDone &record = dones_[index];
+  const auto has = [&](int field) { return record.has_bits >> field & 1; };
+  Done done;
+  if (has(Done::kDoneTypeFieldNumber) &&
+      Done::DoneType_IsValid(record.done_type)) {
+    done.set_done_type(static_cast<Done::DoneType>(record.done_type));
+  }
+  if (has(Done::kStartTimeFieldNumber)) {
+    done.set_start_time(std::string(String(record.start_time)));
+  }
+  if (has(Done::kEndTimeFieldNumber)) {
+    done.set_end_time(std::string(String(record.end_time)));
+  }
+  if (has(Done::kTodoFieldNumber)) {
+    done.set_todo(std::string(String(record.todo)));
+  }
+  if (has(Done::kDurationSecondsFieldNumber)) {
+    done.set_duration_seconds(record.duration_seconds);
+  }
+  if (has(Done::kStartTimeUsFieldNumber)) {
+    done.set_start_time_us(record.start_time_us);
+  }
+  if (has(Done::kEndTimeUsFieldNumber)) {
+    done.set_end_time_us(record.end_time_us);
+  }
+  if (has(Done::kUtcOffsetSecondsFieldNumber)) {
+    done.set_utc_offset_seconds(record.utc_offset_seconds);
+  }
+  if (has(Done::kTodoIdFieldNumber)) {
+    done.set_todo_id(record.todo_id);
+  }
+  return done;
+}
+
+std::string_view FlatState::String(FlatString string) const {
+  if (string.offset > strings_.size() ||
+      string.size > strings_.size() - string.offset) {
+    return {};
+  }
+  return strings_.substr(string.offset, string.size);
+}
@@ -0,0 +1,143 @@
+#ifndef POMODORO_FLAT_STATE_H_
+#define POMODORO_FLAT_STATE_H_
+
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+
+#include "state.pb.h"
+
+// A state file that is read without parsing: it is mapped read-only and read
+// through fixed-size records. Opening it costs the same whatever the size of
+// the history, and pages that are never read, e.g. the history before it is
+// needed, are never loaded.
+//
+// The file starts with a FlatHeader, whose sections give the offset and
+// count of each array that follows it: todos, phases, dones and the string
+// pool that their FlatStrings point into. The phases repeat type and
+// duration of the dones, packed, for the first frame. Integers are in the
+// writer's byte order, so a file from a machine of the other order is
+// rejected by its magic number.
+//
+// Files are only ever replaced by renaming a new one over them, so a mapping
+// keeps seeing the file it mapped.
+//
+// Nothing is used in place for long. State copies the todos and phases when
+// it is constructed, and every Done once history() is first needed. What the
+// file saves is the parsing, so that the first frame, which only needs the
+// todos and phases, is drawn soon.
+
+// A string in the pool.
+struct FlatString {
+  uint32_t offset;
+  uint32_t size;
+};
+
+struct FlatSection {
+  uint64_t offset;
+  uint64_t count;
+};
+
+struct FlatHeader {
+  static constexpr uint64_t kMagic = 0x3174616c66647063; // "cpdflat1"
+  static constexpr uint32_t kVersion = 2;
+
+  uint64_t magic;
+  uint32_t version;
+  uint32_t padding;
+  uint64_t journal_sequence;
+  uint64_t next_todo_id;
+  FlatString day;
+  // A serialized PomodoroStatus, empty if there is none.
+  FlatString pomodoro;
+  FlatSection todos;
+  FlatSection phases;
+  FlatSection dones;
+  // Count is in bytes.
+  FlatSection strings;
+};
+
+struct FlatTodo {
+  uint64_t id;
+  FlatString text;
+  uint32_t done;
+  uint32_t padding;
+};
+
+struct FlatPhase {
+  int32_t type;
+  uint32_t padding;
+  double duration_seconds;
+};
+
+// All fields of a Done. `has_bits` has bit n set if field number n is set.
+struct FlatDone {
+  int64_t start_time_us;
+  int64_t end_time_us;
+  double duration_seconds;
+  uint64_t todo_id;
+  FlatString todo;
+  FlatString start_time;
+  FlatString end_time;
+  int32_t done_type;
+  int32_t utc_offset_seconds;
+  uint32_t has_bits;
+  uint32_t padding;
+};
+
+// Sections follow each other with nothing but this alignment in between.
+inline constexpr size_t kFlatAlignment = 8;
+static_assert(sizeof(FlatHeader) % kFlatAlignment == 0);
+static_assert(sizeof(FlatTodo) % kFlatAlignment == 0);
+static_assert(sizeof(FlatPhase) % kFlatAlignment == 0);
+static_assert(sizeof(FlatDone) % kFlatAlignment == 0);
+
+// A flat state file, mapped for reading.
+class FlatState {
+public:
+  struct Todo {
+    uint64_t id;
+    bool done;
+    std::string_view text;
+  };
+
+  // Maps the file at `path`. Returns null if it is missing or not a valid
+  // flat state file. Shared, so that copies of a State keep it mapped.
+  static std::shared_ptr<const FlatState> Open(const std::string &path);
+  ~FlatState();
+  FlatState(const FlatState &) = delete;
+  FlatState &operator=(const FlatState &) = delete;
+
+  std::string_view day() const { return String(header().day); }
+  uint64_t journal_sequence() const { return header().journal_sequence; }
+  uint64_t next_todo_id() const { return header().next_todo_id; }
+  std::optional<PomodoroStatus> pomodoro() const;
+
+  int todo_count() const { return todos_.size(); }
+  Todo todo(int index) const;
+  std::span<const FlatPhase> phases() const { return phases_; }
+  int done_count() const { return dones_.size(); }
+  // Builds the Done at `index` from its record.
+  Done done(int index) const;
+
+private:
+  FlatState(const char *data, size_t size);
+
+  const FlatHeader &header() const {
+    return *reinterpret_cast<const FlatHeader *>(data_);
+  }
+  // Empty if `string` is not within the pool.
+  std::string_view String(FlatString string) const;
+
+  const char *data_;
+  size_t size_;
+  std::span<const FlatTodo> todos_;
+  std::span<const FlatPhase> phases_;
+  std::span<const FlatDone> dones_;
+  std::string_view strings_;
+};
+
+#endif // POMODORO_FLAT_STATE_H_
@@ -0,0 +1,37 @@
+#ifndef POMODORO_HISTORY_BLOCK_H_
+#define POMODORO_HISTORY_BLOCK_H_
+
+#include <string>
+#include <string_view>
+
+#include "state.pb.h"
+
+// A day of history stored column by column, for the archive.
+//
+// A serialized Done repeats every field's tag, its full todo text and two
+// 64-bit timestamps. A block instead stores each field of all Dones together:
+//   - which fields are set, as runs of equal field masks,
+//   - done types, bit-packed,
+//   - start times as varint deltas from the previous start, and end times as
+//     deltas from their own start,
+//   - UTC offsets as runs,
+//   - durations as varints in the coarsest of seconds, milliseconds and
+//     microseconds that holds them all exactly, or raw if none does,
+//   - todo texts as a dictionary of distinct texts and bit-packed indexes,
+//   - todo IDs as deltas from the previous one.
+// The rest of the TodayHistoryProto is kept serialized. A block needs nothing
+// but itself to be decoded, and decodes to exactly the proto it was encoded
+// from. It ends with a checksum, so that a corrupt block is rejected rather
+// than decoded to different Dones.
+
+// Encodes `history` into `block`. Returns false if a Done has fields unknown
+// to this version, which the columns cannot hold.
+bool EncodeHistoryBlock(const TodayHistoryProto &history, std::string *block);
+// Returns false if `block` is not a valid block.
+bool DecodeHistoryBlock(std::string_view block, TodayHistoryProto *history);
+
+// Whether `data` is a block rather than a serialized TodayHistoryProto. The
+// first byte of a block has wire type 7, which no serialized proto has.
+bool IsHistoryBlock(std::string_view data);
+
+#endif // POMODORO_HISTORY_BLOCK_H_
@@ -0,0 +1,191 @@
+#include "history_block.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "state.pb.h"
+
+namespace {
+
+// Encodes and decodes `history`, which must come back byte for byte.
+void ExpectRoundTrip(const TodayHistoryProto &history) {
+  std::string block;
+  ASSERT_TRUE(EncodeHistoryBlock(history, &block));
+  EXPECT_TRUE(IsHistoryBlock(block));
+  TodayHistoryProto decoded;
+  decoded.set_day("overwritten");
+  ASSERT_TRUE(DecodeHistoryBlock(block, &decoded));
+  EXPECT_EQ(decoded.SerializeAsString(), history.SerializeAsString())
+      << history.DebugString();
+}
+
+Done MakeDone(int i) {
+  Done done;
+  done.set_done_type(i % 3 == 2 ? Done::BREAK : Done::WORK);
+  done.set_todo("Todo " + std::to_string(i % 4));
+  done.set_duration_seconds(i % 3 == 2 ? 300 : 1500);
+  done.set_start_time_us(1618812000000000 + int64_t{i} * 1800000000);
+  done.set_end_time_us(done.start_time_us() + 1500000000);
+  done.set_utc_offset_seconds(7200);
+  done.set_todo_id(i % 4 + 1);
+  return done;
+}
+
+TodayHistoryProto MakeDay(int dones) {
+  TodayHistoryProto history;
+  history.set_day("2021-04-19");
+  for (int i = 0; i < dones; ++i) {
+    *history.add_done() = MakeDone(i);
+  }
+  return history;
+}
+
+TEST(HistoryBlockTest, RoundTripsEmptyDays) {
+  ExpectRoundTrip(TodayHistoryProto());
+  ExpectRoundTrip(MakeDay(0));
+}
+
+TEST(HistoryBlockTest, RoundTripsWholeAndFractionalDurations) {
+  TodayHistoryProto history = MakeDay(20);
+  ExpectRoundTrip(history);
+  history.mutable_done(3)->set_duration_seconds(1500.125);
+  ExpectRoundTrip(history);
+  history.mutable_done(4)->set_duration_seconds(1500.000125);
+  ExpectRoundTrip(history);
+  // Needs the raw doubles.
+  history.mutable_done(5)->set_duration_seconds(std::ldexp(1.0, -40));
+  ExpectRoundTrip(history);
+  history.mutable_done(6)->set_duration_seconds(1e300);
+  ExpectRoundTrip(history);
+}
+
+TEST(HistoryBlockTest, RoundTripsSignedZeroAndNan) {
+  TodayHistoryProto history = MakeDay(4);
+  history.mutable_done(0)->set_duration_seconds(-0.0);
+  ExpectRoundTrip(history);
+  history.mutable_done(1)->set_duration_seconds(
+      std::numeric_limits<double>::quiet_NaN());
+  history.mutable_done(2)->set_duration_seconds(
+      -std::numeric_limits<double>::infinity());
+  ExpectRoundTrip(history);
+}
+
+TEST(HistoryBlockTest, RoundTripsExtremeValues) {
+  TodayHistoryProto history = MakeDay(4);
+  history.mutable_done(0)->set_start_time_us(
+      std::numeric_limits<int64_t>::min());
+  history.mutable_done(1)->set_end_time_us(
+      std::numeric_limits<int64_t>::max());
+  history.mutable_done(2)->set_todo_id(std::numeric_limits<uint64_t>::max());
+  history.mutable_done(3)->set_utc_offset_seconds(-43200);
+  ExpectRoundTrip(history);
+}
+
+TEST(HistoryBlockTest, RoundTripsLegacyTimesAndImportedTodos) {
+  TodayHistoryProto history;
+  history.set_day("2015-03-02");
+  for (int i = 0; i < 5; ++i) {
+    Done *done = history.add_done();
+    done->set_done_type(Done::WORK);
+    done->set_start_time("09:" + std::to_string(10 + i));
+    if (i != 2) {
+      done->set_end_time("09:" + std::to_string(35 + i));
+    }
+    done->set_todo("imported");
+  }
+  history.add_done()->set_start_time("");
+  for (int i = 0; i < 3; ++i) {
+    TodoProto *todo = history.add_todo();
+    todo->set_text("left over " + std::to_string(i));
+    todo->set_done(i == 1);
+  }
+  ExpectRoundTrip(history);
+}
+
+TEST(HistoryBlockTest, RoundTripsRandomFieldMasks) {
+  std::mt19937_64 random(1);
+  const auto one_in = [&](int n) { return random() % n == 0; };
+  for (int day = 0; day < 500; ++day) {
+    TodayHistoryProto history;
+    if (!one_in(4)) {
+      history.set_day("2021-04-" + std::to_string(10 + random() % 20));
+    }
+    if (one_in(5)) {
+      history.add_todo()->set_text("imported");
+    }
+    const int dones = random() % 60;
+    for (int i = 0; i < dones; ++i) {
+      Done *done = history.add_done();
+      if (!one_in(10)) {
+        done->set_done_type(static_cast<Done::DoneType>(random() % 3));
+      }
+      if (one_in(8)) {
+        done->set_start_time("08:0" + std::to_string(random() % 10));
+      }
+      if (one_in(8)) {
+        done->set_end_time("09:1" + std::to_string(random() % 10));
+      }
+      if (!one_in(10)) {
+        done->set_todo("todo " + std::to_string(random() % (day % 7 + 1)));
+      }
+      if (!one_in(10)) {
+        const double durations[] = {1500, 1500.125, 1500.000125,
+                                    std::ldexp(double(random() % 1000), -17)};
+        done->set_duration_seconds(durations[random() % 4]);
+      }
+      if (!one_in(10)) {
+        done->set_start_time_us(static_cast<int64_t>(random() >> 2));
+      }
+      if (!one_in(10)) {
+        done->set_end_time_us(done->start_time_us() + random() % 100000000);
+      }
+      if (!one_in(3)) {
+        done->set_utc_offset_seconds(one_in(5) ? -3600 : 7200);
+      }
+      if (!one_in(4)) {
+        done->set_todo_id(random() % 100);
+      }
+    }
+    ASSERT_NO_FATAL_FAILURE(ExpectRoundTrip(history)) << "day " << day;
+  }
+}
+
+TEST(HistoryBlockTest, RejectsTruncatedBlocks) {
+  std::string block;
+  ASSERT_TRUE(EncodeHistoryBlock(MakeDay(30), &block));
+  for (size_t size = 0; size < block.size(); ++size) {
+    TodayHistoryProto history;
+    EXPECT_FALSE(DecodeHistoryBlock(block.substr(0, size), &history))
+        << "size " << size;
+  }
+}
+
+TEST(HistoryBlockTest, RejectsFlippedBits) {
+  TodayHistoryProto day = MakeDay(30);
+  day.mutable_done(7)->set_duration_seconds(1500.5);
+  day.add_todo()->set_text("imported");
+  std::string block;
+  ASSERT_TRUE(EncodeHistoryBlock(day, &block));
+  for (size_t bit = 0; bit < 8 * block.size(); ++bit) {
+    std::string corrupt = block;
+    corrupt[bit / 8] ^= 1 << bit % 8;
+    TodayHistoryProto history;
+    EXPECT_FALSE(DecodeHistoryBlock(corrupt, &history)) << "bit " << bit;
+  }
+}
+
+TEST(HistoryBlockTest, TellsBlocksFromProtos) {
+  const TodayHistoryProto history = MakeDay(3);
+  std::string block;
+  ASSERT_TRUE(EncodeHistoryBlock(history, &block));
+  EXPECT_TRUE(IsHistoryBlock(block));
+  EXPECT_FALSE(IsHistoryBlock(history.SerializeAsString()));
+  TodayHistoryProto decoded;
+  EXPECT_FALSE(DecodeHistoryBlock(history.SerializeAsString(), &decoded));
+}
+
+} // namespace
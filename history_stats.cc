@@ -0,0 +1,281 @@
+#include "history_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <iomanip>
+#include <optional>
+#include <string>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define POMODORO_HAVE_AVX2 1
+#endif
+
+#include "time_utils.h"
+
+namespace {
+
+constexpr double kInfinity = std::numeric_limits<double>::infinity();
+
+// Accumulators of two AVX2 registers of four doubles each, so that two
+// additions are in flight. Element i of a range goes to lane i % kLanes.
+constexpr int kLanes = 8;
+
+struct Lanes {
+  double seconds[kLanes] = {};
+  double overtime[kLanes] = {};
+  int64_t count[kLanes] = {};
+  double min[kLanes] = {kInfinity, kInfinity, kInfinity, kInfinity,
+                        kInfinity, kInfinity, kInfinity, kInfinity};
+  double max[kLanes] = {-kInfinity, -kInfinity, -kInfinity, -kInfinity,
+                        -kInfinity, -kInfinity, -kInfinity, -kInfinity};
+};
+
+// Adds elements [begin, end) of a range to their lanes. Written to do what
+// the AVX2 instructions do, down to NaNs and signed zeros.
+void AddToLanes(const int32_t *types, const double *durations, size_t begin,
+                size_t end, int32_t type, double threshold, Lanes &lanes) {
+  for (size_t i = begin; i < end; ++i) {
+    const int lane = i % kLanes;
+    const bool match = types[i] == type;
+    const double duration = durations[i];
+    double over = duration - threshold;
+    over = over > 0.0 ? over : 0.0;
+    lanes.seconds[lane] += match ? duration : 0.0;
+    lanes.overtime[lane] += match ? over : 0.0;
+    lanes.count[lane] += match;
+    const double low = match ? duration : kInfinity;
+    const double high = match ? duration : -kInfinity;
+    lanes.min[lane] = lanes.min[lane] < low ? lanes.min[lane] : low;
+    lanes.max[lane] = lanes.max[lane] > high ? lanes.max[lane] : high;
+  }
+}
+
+TypeStats ReduceLanes(const Lanes &lanes) {
+  TypeStats stats;
+  for (int lane = 0; lane < kLanes; ++lane) {
+    stats.count += lanes.count[lane];
+    stats.seconds += lanes.seconds[lane];
+    stats.overtime_seconds += lanes.overtime[lane];
+    stats.min_seconds = stats.min_seconds < lanes.min[lane]
+                            ? stats.min_seconds
+                            : lanes.min[lane];
+    stats.max_seconds = stats.max_seconds > lanes.max[lane]
+                            ? stats.max_seconds
+                            : lanes.max[lane];
+  }
+  // Which of two NaNs a sum keeps depends on the order of its operands, which
+  // compilers may swap in the scalar kernel.
+  if (std::isnan(stats.seconds)) {
+    stats.seconds = std::numeric_limits<double>::quiet_NaN();
+  }
+  return stats;
+}
+
+TypeStats AggregateScalar(const int32_t *types, const double *durations,
+                          size_t size, int32_t type, double threshold) {
+  Lanes lanes;
+  AddToLanes(types, durations, 0, size, type, threshold, lanes);
+  return ReduceLanes(lanes);
+}
+
+// The end of the run of equal days starting at `begin`.
+size_t RunEndScalar(const int32_t *days, size_t begin, size_t size) {
+  size_t end = begin + 1;
+  while (end < size && days[end] == days[begin]) {
+    ++end;
+  }
+  return end;
+}
+
+#ifdef POMODORO_HAVE_AVX2
+
+__attribute__((target("avx2"))) TypeStats
+AggregateAvx2(const int32_t *types, const double *durations, size_t size,
+              int32_t type, double threshold) {
+  const __m128i type_vector = _mm_set1_epi32(type);
+  const __m256d threshold_vector = _mm256_set1_pd(threshold);
+  const __m256d zero = _mm256_setzero_pd();
+  const __m256d infinity = _mm256_set1_pd(kInfinity);
+  const __m256d minus_infinity = _mm256_set1_pd(-kInfinity);
+  __m256d seconds[2] = {zero, zero};
+  __m256d overtime[2] = {zero, zero};
+  __m256i count[2] = {_mm256_setzero_si256(), _mm256_setzero_si256()};
+  __m256d min[2] = {infinity, infinity};
+  __m256d max[2] = {minus_infinity, minus_infinity};
+
+  size_t i = 0;
+  for (; i + kLanes <= size; i += kLanes) {
+    for (int half = 0; half < 2; ++half) {
+      const size_t j = i + 4 * half;
+      // All ones in the 64-bit lanes of matching Dones.
+      const __m256i match = _mm256_cvtepi32_epi64(_mm_cmpeq_epi32(
+          _mm_loadu_si128(reinterpret_cast<const __m128i *>(types + j)),
+          type_vector));
+      const __m256d mask = _mm256_castsi256_pd(match);
+      const __m256d duration = _mm256_loadu_pd(durations + j);
+      const __m256d over =
+          _mm256_max_pd(_mm256_sub_pd(duration, threshold_vector), zero);
+      seconds[half] =
+          _mm256_add_pd(seconds[half], _mm256_and_pd(duration, mask));
+      overtime[half] = _mm256_add_pd(overtime[half], _mm256_and_pd(over, mask));
+      count[half] = _mm256_sub_epi64(count[half], match);
+      min[half] =
+          _mm256_min_pd(min[half], _mm256_blendv_pd(infinity, duration, mask));
+      max[half] = _mm256_max_pd(
+          max[half], _mm256_blendv_pd(minus_infinity, duration, mask));
+    }
+  }
+
+  Lanes lanes;
+  for (int half = 0; half < 2; ++half) {
+    _mm256_storeu_pd(lanes.seconds + 4 * half, seconds[half]);
+    _mm256_storeu_pd(lanes.overtime + 4 * half, overtime[half]);
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(lanes.count + 4 * half),
+                        count[half]);
+    _mm256_storeu_pd(lanes.min + 4 * half, min[half]);
+    _mm256_storeu_pd(lanes.max + 4 * half, max[half]);
+  }
+  // The rest is SSE code, which stalls while upper halves are dirty.
+  // Compilers leave this out when not optimizing.
+  _mm256_zeroupper();
+  AddToLanes(types, durations, i, size, type, threshold, lanes);
+  return ReduceLanes(lanes);
+}
+
+__attribute__((target("avx2"))) size_t RunEndAvx2(const int32_t *days,
+                                                  size_t begin, size_t size) {
+  const __m256i day = _mm256_set1_epi32(days[begin]);
+  size_t end = begin + 1;
+  uint32_t mask = 0xff;
+  for (; end + 8 <= size && mask == 0xff; end += 8) {
+    const __m256i equal = _mm256_cmpeq_epi32(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(days + end)),
+        day);
+    mask = _mm256_movemask_ps(_mm256_castsi256_ps(equal));
+  }
+  // Compilers leave this out when not optimizing.
+  _mm256_zeroupper();
+  if (mask != 0xff) {
+    return end - 8 + std::countr_one(mask);
+  }
+  return RunEndScalar(days, end - 1, size);
+}
+
+#endif // POMODORO_HAVE_AVX2
+
+bool UseAvx2(SimdLevel level) {
+  return level == SimdLevel::kAvx2 && DetectSimdLevel() == SimdLevel::kAvx2;
+}
+
+TypeStats AggregateRange(const HistoryColumns &history, size_t begin,
+                         size_t end, Done::DoneType type, double threshold,
+                         SimdLevel level) {
+  const int32_t *types = history.types.data() + begin;
+  const double *durations = history.durations.data() + begin;
+#ifdef POMODORO_HAVE_AVX2
+  if (UseAvx2(level)) {
+    return AggregateAvx2(types, durations, end - begin, type, threshold);
+  }
+#endif
+  return AggregateScalar(types, durations, end - begin, type, threshold);
+}
+
+std::string Minutes(double seconds) {
+  return std::to_string(std::lround(seconds / 60)) + " min";
+}
+
+void PrintRow(std::ostream &os, const std::string &label, const TypeStats &work,
+              const TypeStats &breaks) {
+  os << "  " << std::left << std::setw(12) << label << std::right
+     << std::setw(5) << work.count << " pomodoros" << std::setw(9)
+     << Minutes(work.seconds) << std::setw(9) << Minutes(work.overtime_seconds)
+     << " over" << std::setw(9) << Minutes(breaks.seconds) << " break";
+  if (work.count > 0) {
+    os << ", " << Minutes(work.min_seconds) << " to "
+       << Minutes(work.max_seconds);
+  }
+  os << "\n";
+}
+
+} // namespace
+
+void HistoryColumns::Append(int day_number, const Done &done) {
+  days.push_back(day_number);
+  types.push_back(done.done_type());
+  durations.push_back(done.duration_seconds());
+}
+
+void HistoryColumns::Append(const TodayHistoryProto &history) {
+  const std::optional<int> day_number = ParseDay(history.day());
+  if (!day_number) {
+    return;
+  }
+  for (const Done &done : history.done()) {
+    Append(*day_number, done);
+  }
+}
+
+void TypeStats::Merge(const TypeStats &other) {
+  count += other.count;
+  seconds += other.seconds;
+  overtime_seconds += other.overtime_seconds;
+  min_seconds = std::min(min_seconds, other.min_seconds);
+  max_seconds = std::max(max_seconds, other.max_seconds);
+}
+
+SimdLevel DetectSimdLevel() {
+#ifdef POMODORO_HAVE_AVX2
+  static const SimdLevel level = __builtin_cpu_supports("avx2")
+                                     ? SimdLevel::kAvx2
+                                     : SimdLevel::kScalar;
+  return level;
+#else
+  return SimdLevel::kScalar;
+#endif
+}
+
+TypeStats Aggregate(const HistoryColumns &history, Done::DoneType type,
+                    double overtime_threshold, SimdLevel level) {
+  return AggregateRange(history, 0, history.size(), type, overtime_threshold,
+                        level);
+}
+
+std::map<int, TypeStats> AggregateByDay(const HistoryColumns &history,
+                                        Done::DoneType type,
+                                        double overtime_threshold,
+                                        SimdLevel level) {
+  // Days come in runs, as they are appended day by day. A day in several
+  // runs is merged.
+  std::map<int, TypeStats> days;
+  for (size_t begin = 0, end; begin < history.size(); begin = end) {
+    const int32_t *day_numbers = history.days.data();
+#ifdef POMODORO_HAVE_AVX2
+    end = UseAvx2(level) ? RunEndAvx2(day_numbers, begin, history.size())
+                         : RunEndScalar(day_numbers, begin, history.size());
+#else
+    end = RunEndScalar(day_numbers, begin, history.size());
+#endif
+    days[history.days[begin]].Merge(AggregateRange(
+        history, begin, end, type, overtime_threshold, level));
+  }
+  return days;
+}
+
+void PrintHistoryStats(std::ostream &os, const HistoryColumns &history,
+                       double overtime_threshold) {
+  const std::map<int, TypeStats> work =
+      AggregateByDay(history, Done::WORK, overtime_threshold);
+  const std::map<int, TypeStats> breaks =
+      AggregateByDay(history, Done::BREAK, overtime_threshold);
+  os << "Days\n";
+  for (const auto &[day, stats] : work) {
+    const auto it = breaks.find(day);
+    PrintRow(os, FormatDay(day), stats,
+             it != breaks.end() ? it->second : TypeStats());
+  }
+  os << "Total\n";
+  PrintRow(os, "", Aggregate(history, Done::WORK, overtime_threshold),
+           Aggregate(history, Done::BREAK, overtime_threshold));
+}
@@ -0,0 +1,62 @@
+#ifndef POMODORO_HISTORY_STATS_H_
+#define POMODORO_HISTORY_STATS_H_
+
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <ostream>
+#include <vector>
+
+#include "state.pb.h"
+
+// History with one array per field, so that aggregations run over dense
+// arrays of numbers instead of a Done message per block.
+struct HistoryColumns {
+  // Days since 1970-01-01.
+  std::vector<int32_t> days;
+  // Done::DoneType.
+  std::vector<int32_t> types;
+  std::vector<double> durations;
+
+  void Append(int day_number, const Done &done);
+  // Appends all Dones of `history`, if its day is valid.
+  void Append(const TodayHistoryProto &history);
+  size_t size() const { return types.size(); }
+};
+
+// Aggregates of the Dones of one type.
+struct TypeStats {
+  int64_t count = 0;
+  double seconds = 0;
+  // Seconds beyond the threshold, summed over the Dones that ran over it.
+  double overtime_seconds = 0;
+  double min_seconds = std::numeric_limits<double>::infinity();
+  double max_seconds = -std::numeric_limits<double>::infinity();
+
+  void Merge(const TypeStats &other);
+};
+
+// The kernels come in plain C++ and in AVX2. Both add up in the same order,
+// so they give the same results to the bit, whichever the CPU runs. Sums that
+// are NaN are all the same NaN.
+enum class SimdLevel { kScalar, kAvx2 };
+// The best level this CPU supports.
+SimdLevel DetectSimdLevel();
+
+// Aggregates the Dones of `type`, with overtime beyond `overtime_threshold`
+// seconds, e.g. kWorkPhaseSeconds.
+TypeStats Aggregate(const HistoryColumns &history, Done::DoneType type,
+                    double overtime_threshold,
+                    SimdLevel level = DetectSimdLevel());
+// Like Aggregate(), per day.
+std::map<int, TypeStats> AggregateByDay(const HistoryColumns &history,
+                                        Done::DoneType type,
+                                        double overtime_threshold,
+                                        SimdLevel level = DetectSimdLevel());
+
+// Prints work and break stats of `history`, with overtime beyond
+// `overtime_threshold`, per day and in total.
+void PrintHistoryStats(std::ostream &os, const HistoryColumns &history,
+                       double overtime_threshold);
+
+#endif // POMODORO_HISTORY_STATS_H_
@@ -0,0 +1,194 @@
+#include "history_stats.h"
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "state.pb.h"
+
+namespace {
+
+constexpr double kThreshold = 1500;
+constexpr Done::DoneType kTypes[] = {Done::DONE_TYPE_UNSPECIFIED, Done::WORK,
+                                     Done::BREAK};
+
+void ExpectIdentical(const TypeStats &scalar, const TypeStats &avx2) {
+  EXPECT_EQ(scalar.count, avx2.count);
+  EXPECT_EQ(std::bit_cast<uint64_t>(scalar.seconds),
+            std::bit_cast<uint64_t>(avx2.seconds))
+      << scalar.seconds << " vs " << avx2.seconds;
+  EXPECT_EQ(std::bit_cast<uint64_t>(scalar.overtime_seconds),
+            std::bit_cast<uint64_t>(avx2.overtime_seconds))
+      << scalar.overtime_seconds << " vs " << avx2.overtime_seconds;
+  EXPECT_EQ(std::bit_cast<uint64_t>(scalar.min_seconds),
+            std::bit_cast<uint64_t>(avx2.min_seconds))
+      << scalar.min_seconds << " vs " << avx2.min_seconds;
+  EXPECT_EQ(std::bit_cast<uint64_t>(scalar.max_seconds),
+            std::bit_cast<uint64_t>(avx2.max_seconds))
+      << scalar.max_seconds << " vs " << avx2.max_seconds;
+}
+
+// Compares both kernels on every type, in total and per day.
+void ExpectSameKernels(const HistoryColumns &history) {
+  for (const Done::DoneType type : kTypes) {
+    SCOPED_TRACE(type);
+    ExpectIdentical(Aggregate(history, type, kThreshold, SimdLevel::kScalar),
+                    Aggregate(history, type, kThreshold, SimdLevel::kAvx2));
+    const std::map<int, TypeStats> scalar =
+        AggregateByDay(history, type, kThreshold, SimdLevel::kScalar);
+    const std::map<int, TypeStats> avx2 =
+        AggregateByDay(history, type, kThreshold, SimdLevel::kAvx2);
+    ASSERT_EQ(scalar.size(), avx2.size());
+    for (const auto &[day, stats] : scalar) {
+      SCOPED_TRACE(day);
+      ASSERT_TRUE(avx2.contains(day));
+      ExpectIdentical(stats, avx2.at(day));
+    }
+  }
+}
+
+void Append(HistoryColumns &history, int day, Done::DoneType type,
+            double duration) {
+  Done done;
+  done.set_done_type(type);
+  done.set_duration_seconds(duration);
+  history.Append(day, done);
+}
+
+HistoryColumns RandomHistory(std::mt19937 &random, int size) {
+  HistoryColumns history;
+  int day = 19000;
+  for (int i = 0; i < size; ++i) {
+    if (random() % 6 == 0) {
+      ++day;
+    }
+    Append(history, day, kTypes[random() % 3],
+           (random() % 4000) / (1.0 + random() % 7) - 100);
+  }
+  return history;
+}
+
+class HistoryStatsAvx2Test : public testing::Test {
+protected:
+  void SetUp() override {
+    if (DetectSimdLevel() == SimdLevel::kScalar) {
+      GTEST_SKIP() << "This CPU has no AVX2.";
+    }
+  }
+};
+
+TEST(HistoryStatsTest, AggregatesScalar) {
+  HistoryColumns history;
+  Append(history, 19000, Done::WORK, 1500);
+  Append(history, 19000, Done::BREAK, 300);
+  Append(history, 19000, Done::WORK, 1800);
+  Append(history, 19001, Done::WORK, 1200);
+  Append(history, 19001, Done::BREAK, 600);
+
+  const TypeStats work =
+      Aggregate(history, Done::WORK, kThreshold, SimdLevel::kScalar);
+  EXPECT_EQ(work.count, 3);
+  EXPECT_EQ(work.seconds, 4500);
+  EXPECT_EQ(work.overtime_seconds, 300);
+  EXPECT_EQ(work.min_seconds, 1200);
+  EXPECT_EQ(work.max_seconds, 1800);
+
+  const std::map<int, TypeStats> breaks =
+      AggregateByDay(history, Done::BREAK, kThreshold, SimdLevel::kScalar);
+  ASSERT_EQ(breaks.size(), 2u);
+  EXPECT_EQ(breaks.at(19000).seconds, 300);
+  EXPECT_EQ(breaks.at(19001).seconds, 600);
+  EXPECT_EQ(breaks.at(19001).overtime_seconds, 0);
+}
+
+TEST(HistoryStatsTest, MergesDaysInSeveralRuns) {
+  HistoryColumns history;
+  Append(history, 19001, Done::WORK, 100);
+  Append(history, 19000, Done::WORK, 200);
+  Append(history, 19001, Done::WORK, 400);
+  const std::map<int, TypeStats> days =
+      AggregateByDay(history, Done::WORK, kThreshold, SimdLevel::kScalar);
+  ASSERT_EQ(days.size(), 2u);
+  EXPECT_EQ(days.at(19001).count, 2);
+  EXPECT_EQ(days.at(19001).seconds, 500);
+  EXPECT_EQ(days.at(19000).seconds, 200);
+}
+
+TEST_F(HistoryStatsAvx2Test, MatchesScalarOnEveryLength) {
+  std::mt19937 random(1);
+  // Covers the empty history, lengths below one chunk of 8 and every tail.
+  for (int size = 0; size <= 72; ++size) {
+    SCOPED_TRACE(size);
+    ASSERT_NO_FATAL_FAILURE(ExpectSameKernels(RandomHistory(random, size)));
+  }
+  for (const int size : {1000, 1001, 1007, 4099}) {
+    SCOPED_TRACE(size);
+    ASSERT_NO_FATAL_FAILURE(ExpectSameKernels(RandomHistory(random, size)));
+  }
+}
+
+TEST_F(HistoryStatsAvx2Test, MatchesScalarOnNanAndSignedZeros) {
+  const double special[] = {0.0, -0.0, std::numeric_limits<double>::quiet_NaN(),
+                            -std::numeric_limits<double>::quiet_NaN(),
+                            std::numeric_limits<double>::infinity(),
+                            -std::numeric_limits<double>::infinity()};
+  std::mt19937 random(2);
+  for (int size : {1, 7, 8, 9, 15, 16, 17, 31, 100}) {
+    for (int repeat = 0; repeat < 20; ++repeat) {
+      HistoryColumns history = RandomHistory(random, size);
+      for (double &duration : history.durations) {
+        if (random() % 3 == 0) {
+          duration = special[random() % std::size(special)];
+        }
+      }
+      SCOPED_TRACE(size);
+      ASSERT_NO_FATAL_FAILURE(ExpectSameKernels(history));
+    }
+  }
+  // Only zeros, of both signs, in either order.
+  for (const double first : {0.0, -0.0}) {
+    HistoryColumns history;
+    for (int i = 0; i < 19; ++i) {
+      Append(history, 19000, Done::WORK, i % 2 == 0 ? first : -first);
+    }
+    ExpectSameKernels(history);
+  }
+}
+
+TEST_F(HistoryStatsAvx2Test, FindsDayRunsInAndAcrossChunks) {
+  // Runs that end inside a chunk of 8, on its boundary and chunks later.
+  const int run_lengths[] = {1, 2, 7, 8, 9, 15, 16, 17, 23, 24, 25, 64, 3};
+  for (int offset = 0; offset < 8; ++offset) {
+    HistoryColumns history;
+    std::map<int, int> expected_counts;
+    int day = 19000;
+    for (int i = 0; i < offset; ++i) {
+      Append(history, day, Done::WORK, 1500);
+      ++expected_counts[day];
+    }
+    for (const int length : run_lengths) {
+      ++day;
+      for (int i = 0; i < length; ++i) {
+        Append(history, day, Done::WORK, 1500 + i);
+        ++expected_counts[day];
+      }
+    }
+    SCOPED_TRACE(offset);
+    ASSERT_NO_FATAL_FAILURE(ExpectSameKernels(history));
+
+    const std::map<int, TypeStats> days =
+        AggregateByDay(history, Done::WORK, kThreshold, SimdLevel::kAvx2);
+    ASSERT_EQ(days.size(), expected_counts.size());
+    for (const auto &[day_number, count] : expected_counts) {
+      EXPECT_EQ(days.at(day_number).count, count) << "day " << day_number;
+    }
+  }
+}
+
+} // namespace
@@ -0,0 +1,278 @@
+#include "importer.h"
+
+#include <algorithm>
+#include <charconv>
+#include <fcntl.h>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+#include "time_utils.h"
+
+namespace {
+
+bool IsDigit(char c) { return c >= '0' && c <= '9'; }
+
+// "YYYY-MM-DD"
+bool IsDayLine(std::string_view line) {
+  if (line.size() != 10 || line[4] != '-' || line[7] != '-') {
+    return false;
+  }
+  for (const int i : {0, 1, 2, 3, 5, 6, 8, 9}) {
+    if (!IsDigit(line[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// "HH:MM"
+bool IsClock(std::string_view text) {
+  return text.size() == 5 && IsDigit(text[0]) && IsDigit(text[1]) &&
+         text[2] == ':' && IsDigit(text[3]) && IsDigit(text[4]);
+}
+
+// Calls `fn` with every line of `text`, without the newline.
+template <typename Fn> void ForEachLine(std::string_view text, Fn fn) {
+  size_t pos = 0;
+  while (pos < text.size()) {
+    const size_t end = std::min(text.find('\n', pos), text.size());
+    fn(text.substr(pos, end - pos));
+    pos = end + 1;
+  }
+}
+
+// Position of the first day line starting at or after `pos`, or the end.
+size_t NextDayLine(std::string_view text, size_t pos) {
+  // Back up to the start of the line `pos` is in the middle of.
+  pos = pos == 0 ? 0 : text.find('\n', pos - 1);
+  while (pos != std::string_view::npos && pos < text.size()) {
+    if (text[pos] == '\n') {
+      ++pos;
+    }
+    const size_t end = std::min(text.find('\n', pos), text.size());
+    if (IsDayLine(text.substr(pos, end - pos))) {
+      return pos;
+    }
+    pos = end;
+  }
+  return text.size();
+}
+
+// Cuts `text` into at most `parts` chunks of about equal size, each but the
+// first starting at a day line.
+std::vector<std::string_view> SplitAtDays(std::string_view text, int parts) {
+  std::vector<std::string_view> chunks;
+  size_t begin = 0;
+  for (int i = 1; i <= parts && begin < text.size(); ++i) {
+    const size_t end =
+        i == parts ? text.size()
+                   : NextDayLine(text, std::max(begin + 1,
+                                                text.size() / parts * i));
+    chunks.push_back(text.substr(begin, end - begin));
+    begin = end;
+  }
+  return chunks;
+}
+
+bool ParseTodoLine(std::string_view line, TodoRecord *record) {
+  if (line.size() < 3 || line[0] != ' ' || line[2] != ' ' ||
+      (line[1] != ' ' && line[1] != 'x')) {
+    return false;
+  }
+  *record = {.done = line[1] == 'x', .text = line.substr(3)};
+  return true;
+}
+
+bool ParseWorkLine(std::string_view line, WorkRecord *record) {
+  // "  HH:MM HH:MM Nm text"
+  if (line.size() < 17 || !line.starts_with("  ") || line[7] != ' ' ||
+      line[13] != ' ') {
+    return false;
+  }
+  const std::string_view start = line.substr(2, 5);
+  const std::string_view end = line.substr(8, 5);
+  if (!IsClock(start) || !IsClock(end)) {
+    return false;
+  }
+  int minutes;
+  const char *const first = line.data() + 14;
+  const char *const last = line.data() + line.size();
+  const auto [ptr, error] = std::from_chars(first, last, minutes);
+  if (error != std::errc() || ptr == first || ptr == last || *ptr != 'm') {
+    return false;
+  }
+  const size_t todo = ptr - line.data() + 2;
+  *record = {.start = start,
+             .end = end,
+             .minutes = minutes,
+             .todo = todo <= line.size() ? line.substr(todo) : ""};
+  return true;
+}
+
+template <typename Record, typename ParseLine>
+std::vector<DayBlock<Record>> ParseChunk(std::string_view chunk,
+                                         ParseLine parse_line) {
+  std::vector<DayBlock<Record>> blocks;
+  ForEachLine(chunk, [&](std::string_view line) {
+    Record record;
+    if (IsDayLine(line)) {
+      blocks.push_back({.day = line, .records = {}});
+    } else if (!blocks.empty() && parse_line(line, &record)) {
+      blocks.back().records.push_back(record);
+    }
+  });
+  return blocks;
+}
+
+template <typename Record, typename ParseLine>
+std::vector<DayBlock<Record>> ParseLog(std::string_view text, int threads,
+                                       ParseLine parse_line) {
+  const std::vector<std::string_view> chunks =
+      SplitAtDays(text, std::max(threads, 1));
+  std::vector<std::vector<DayBlock<Record>>> parsed(chunks.size());
+  std::vector<std::thread> workers;
+  for (size_t i = 1; i < chunks.size(); ++i) {
+    workers.emplace_back([&, i] {
+      parsed[i] = ParseChunk<Record>(chunks[i], parse_line);
+    });
+  }
+  if (!chunks.empty()) {
+    parsed[0] = ParseChunk<Record>(chunks[0], parse_line);
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  std::vector<DayBlock<Record>> blocks = std::move(parsed.front());
+  for (size_t i = 1; i < parsed.size(); ++i) {
+    std::move(parsed[i].begin(), parsed[i].end(), std::back_inserter(blocks));
+  }
+  return blocks;
+}
+
+} // namespace
+
+MappedFile::MappedFile(const std::string &path) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return;
+  }
+  struct stat st;
+  if (fstat(fd, &st) == 0) {
+    size_ = st.st_size;
+    if (size_ == 0) {
+      ok_ = true;
+    } else if (void *data = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+               data != MAP_FAILED) {
+      // The parsers read front to back.
+      madvise(data, size_, MADV_SEQUENTIAL);
+      data_ = static_cast<const char *>(data);
+      ok_ = true;
+    }
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile() {
+  if (data_) {
+    munmap(const_cast<char *>(data_), size_);
+  }
+}
+
+std::vector<DayBlock<TodoRecord>> ParseTodoLog(std::string_view text,
+                                               int threads) {
+  if (text.empty()) {
+    return {};
+  }
+  return ParseLog<TodoRecord>(text, threads, ParseTodoLine);
+}
+
+std::vector<DayBlock<WorkRecord>> ParseHistoryLog(std::string_view text,
+                                                  int threads) {
+  if (text.empty()) {
+    return {};
+  }
+  return ParseLog<WorkRecord>(text, threads, ParseWorkLine);
+}
+
+ImportStats ImportLogs(const std::string &todo_txt_path,
+                       const std::string &history_txt_path, int until,
+                       HistoryArchive &archive, int threads) {
+  ImportStats stats;
+  const MappedFile todo_txt(todo_txt_path);
+  const MappedFile history_txt(history_txt_path);
+  for (const auto &[file, path] :
+       {std::pair(&todo_txt, &todo_txt_path),
+        std::pair(&history_txt, &history_txt_path)}) {
+    if (!file->ok()) {
+      std::cout << "Could not read '" << *path << "'.\n";
+    }
+    stats.bytes += file->data().size();
+  }
+
+  const std::vector<DayBlock<TodoRecord>> todo_blocks =
+      ParseTodoLog(todo_txt.data(), threads);
+  const std::vector<DayBlock<WorkRecord>> work_blocks =
+      ParseHistoryLog(history_txt.data(), threads);
+
+  // The last block of every day, by day number.
+  struct Blocks {
+    const DayBlock<TodoRecord> *todos = nullptr;
+    const DayBlock<WorkRecord> *work = nullptr;
+  };
+  std::map<int, Blocks> days;
+  for (const DayBlock<TodoRecord> &block : todo_blocks) {
+    const std::optional<int> day = ParseDay(std::string(block.day));
+    if (day && *day < until) {
+      days[*day].todos = &block;
+    }
+  }
+  for (const DayBlock<WorkRecord> &block : work_blocks) {
+    const std::optional<int> day = ParseDay(std::string(block.day));
+    if (day && *day < until) {
+      days[*day].work = &block;
+    }
+  }
+
+  for (const auto &[day_number, blocks] : days) {
+    const std::string day = FormatDay(day_number);
+    TodayHistoryProto history = archive.Day(day);
+    history.set_day(day);
+    const bool has_work = history.done_size() > 0;
+    const bool has_todos = history.todo_size() > 0;
+    if (blocks.work && !has_work) {
+      for (const WorkRecord &record : blocks.work->records) {
+        Done *done = history.add_done();
+        done->set_done_type(Done::WORK);
+        done->set_start_time(std::string(record.start));
+        done->set_end_time(std::string(record.end));
+        done->set_duration_seconds(record.minutes * 60);
+        done->set_todo(std::string(record.todo));
+        UpgradeDoneTimes(day, done);
+        ++stats.work;
+      }
+    }
+    if (blocks.todos && !has_todos) {
+      for (const TodoRecord &record : blocks.todos->records) {
+        TodoProto *todo = history.add_todo();
+        todo->set_text(std::string(record.text));
+        if (record.done) {
+          todo->set_done(true);
+        }
+        ++stats.todos;
+      }
+    }
+    // Importing the same logs again leaves the archive alone.
+    const bool changed = (history.done_size() > 0 && !has_work) ||
+                         (history.todo_size() > 0 && !has_todos);
+    if (changed && archive.Put(history)) {
+      ++stats.days;
+    }
+  }
+  return stats;
+}
@@ -0,0 +1,74 @@
+#ifndef POMODORO_IMPORTER_H_
+#define POMODORO_IMPORTER_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "archive.h"
+
+// A whole file mapped read-only into memory.
+class MappedFile {
+public:
+  // Maps the file at `path`. Check ok() for errors.
+  explicit MappedFile(const std::string &path);
+  ~MappedFile();
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  bool ok() const { return ok_; }
+  std::string_view data() const { return {data_, size_}; }
+
+private:
+  bool ok_ = false;
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+};
+
+// A line "  x text" of todo.txt, as written by SaveTodo().
+struct TodoRecord {
+  bool done;
+  std::string_view text;
+};
+
+// A line "  HH:MM HH:MM Nm text" of todo.history.txt, as written by
+// SaveTodayTxt().
+struct WorkRecord {
+  std::string_view start;
+  std::string_view end;
+  int minutes;
+  std::string_view todo;
+};
+
+// The records following one "YYYY-MM-DD" line.
+template <typename Record> struct DayBlock {
+  std::string_view day;
+  std::vector<Record> records;
+};
+
+// Parse the blocks of a log, in file order. The text is cut at day lines
+// into `threads` chunks that are parsed in parallel. The results point into
+// `text`, nothing is copied. Lines that do not parse are skipped.
+std::vector<DayBlock<TodoRecord>> ParseTodoLog(std::string_view text,
+                                               int threads);
+std::vector<DayBlock<WorkRecord>> ParseHistoryLog(std::string_view text,
+                                                  int threads);
+
+struct ImportStats {
+  int64_t bytes = 0;
+  int64_t days = 0;
+  int64_t todos = 0;
+  int64_t work = 0;
+};
+
+// Imports the days before `until` (days since 1970-01-01) of the todo.txt and
+// todo.history.txt logs into `archive`. Later days are still in the state.
+// Both logs get a new block whenever the tool exits, so the last block of a
+// day is the complete one. Days the archive already has work for keep it,
+// since the archive also knows about breaks.
+ImportStats ImportLogs(const std::string &todo_txt_path,
+                       const std::string &history_txt_path, int until,
+                       HistoryArchive &archive, int threads);
+
+#endif // POMODORO_IMPORTER_H_
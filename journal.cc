@@ -0,0 +1,107 @@
+#include "journal.h"
+
+#include <fcntl.h>
+#include <iostream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "trace.h"
+
+namespace {
+
+constexpr int kHeaderSize = 2 * sizeof(uint32_t);
+
+uint32_t Checksum(const std::string &data) {
+  uint32_t hash = 2166136261u;
+  for (const char c : data) {
+    hash = (hash ^ static_cast<uint8_t>(c)) * 16777619u;
+  }
+  return hash;
+}
+
+} // namespace
+
+Journal::Journal(const std::string &path)
+    : path_(path),
+      fd_(open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644)) {
+  if (fd_ < 0) {
+    std::cout << "Could not open journal '" << path_ << "'.\n";
+    return;
+  }
+  struct stat st;
+  if (fstat(fd_, &st) == 0) {
+    size_bytes_ = st.st_size;
+  }
+}
+
+Journal::~Journal() {
+  if (fd_ >= 0) {
+    close(fd_);
+  }
+}
+
+int Journal::Replay(const std::string &path, State &state) {
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+
+  int applied = 0;
+  {
+    google::protobuf::io::FileInputStream file(fd);
+    google::protobuf::io::CodedInputStream input(&file);
+    uint32_t length, checksum;
+    std::string payload;
+    Mutation mutation;
+    while (input.ReadLittleEndian32(&length) &&
+           input.ReadLittleEndian32(&checksum) &&
+           input.ReadString(&payload, length)) {
+      if (Checksum(payload) != checksum || !mutation.ParseFromString(payload)) {
+        std::cout << "Ignoring corrupt tail of journal '" << path << "'.\n";
+        break;
+      }
+      if (mutation.sequence() > state.sequence()) {
+        state.Apply(mutation);
+        ++applied;
+      }
+    }
+  }
+  close(fd);
+  return applied;
+}
+
+void Journal::OnMutation(const Mutation &mutation) {
+  TRACE_SPAN("Journal::OnMutation");
+  if (fd_ < 0) {
+    return;
+  }
+
+  const std::string payload = mutation.SerializeAsString();
+  std::string record(kHeaderSize, '\0');
+  auto *header = reinterpret_cast<uint8_t *>(record.data());
+  header = google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      payload.size(), header);
+  google::protobuf::io::CodedOutputStream::WriteLittleEndian32ToArray(
+      Checksum(payload), header);
+  record += payload;
+
+  // A single write per record, so records of a killed process are either
+  // complete or torn at the very end of the log.
+  if (write(fd_, record.data(), record.size()) !=
+      static_cast<ssize_t>(record.size())) {
+    std::cout << "Could not write to journal '" << path_ << "'.\n";
+    return;
+  }
+  size_bytes_ += record.size();
+}
+
+void Journal::Truncate() {
+  if (fd_ < 0) {
+    return;
+  }
+  if (ftruncate(fd_, 0) == 0) {
+    size_bytes_ = 0;
+  }
+}
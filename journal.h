@@ -0,0 +1,42 @@
+#ifndef POMODORO_JOURNAL_H_
+#define POMODORO_JOURNAL_H_
+
+#include <cstdint>
+#include <string>
+
+#include "state.h"
+#include "state.pb.h"
+
+// Append-only log of State mutations. Every change is written as a small
+// framed record when it happens, so that a crash loses nothing that was
+// already on screen. The log is emptied once a snapshot of the state that
+// contains all of its records has been saved.
+//
+// Record framing: little endian uint32 payload length, little endian uint32
+// FNV-1a checksum of the payload, serialized Mutation.
+class Journal : public State::Observer {
+public:
+  explicit Journal(const std::string &path);
+  ~Journal() override;
+  Journal(const Journal &) = delete;
+  Journal &operator=(const Journal &) = delete;
+
+  // Applies all records of the log at `path` that are newer than `state`.
+  // Stops at the first torn or corrupt record. Returns the number of applied
+  // records.
+  static int Replay(const std::string &path, State &state);
+
+  void OnMutation(const Mutation &mutation) override;
+
+  int64_t size_bytes() const { return size_bytes_; }
+
+  // Drops all records. Only call after saving a snapshot that contains them.
+  void Truncate();
+
+private:
+  std::string path_;
+  int fd_;
+  int64_t size_bytes_ = 0;
+};
+
+#endif // POMODORO_JOURNAL_H_
@@ -1,435 +1,648 @@
+#include <algorithm>
 #include <chrono>
 #include <cmath>
-#include <fstream>
-#include <iomanip>
+#include <cstdint>
+#include <cstdlib>
 #include <iostream>
 #include <locale.h>
+#include <memory>
+#include <optional>
+#include <signal.h>
 #include <string>
+#include <string_view>
+#include <sys/signalfd.h>
 #include <thread>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
 #include <vector>
 
 #include "ncurses.h"
 
+#include "archive.h"
+#include "channel.h"
+#include "curses_screen.h"
+#include "daemon.h"
+#include "event_loop.h"
+#include "flat_state.h"
+#include "history_stats.h"
+#include "importer.h"
+#include "journal.h"
+#include "persistence.h"
+#include "render.h"
+#include "report.h"
+#include "search.h"
+#include "simulation.h"
 #include "state.h"
 #include "state.pb.h"
-#include "time_utils.h"
-
-constexpr double kWorkPhaseSeconds = 25 * 60;
-constexpr double kShortBreakSeconds = 5 * 60;
-constexpr double kLongBreakSeconds = 15 * 60;
+#include "status_writer.h"
+#include "storage.h"
+#include "team_load.h"
+#include "team_server.h"
+#include "trace.h"
+#include "ui.h"
 
 constexpr char todo_txt_path[] = "/Users/hosang/todo.txt";
 constexpr char todo_history_path[] = "/Users/hosang/todo.history.txt";
 constexpr char state_path[] = "/Users/hosang/todo.StateProto.bp";
+constexpr char flat_state_path[] = "/Users/hosang/todo.flat";
+constexpr char journal_path[] = "/Users/hosang/todo.journal";
+constexpr char archive_path[] = "/Users/hosang/todo.archive.bp";
+constexpr char socket_path[] = "/Users/hosang/cprd.socket";
+constexpr char status_page_path[] = "/Users/hosang/cprd.status";
+constexpr char team_socket_path[] = "/Users/hosang/cprd.team.socket";
+constexpr char team_directory[] = "/Users/hosang/team";
+// Only written when built with POMODORO_TRACING.
+constexpr char trace_path[] = "/Users/hosang/cprd.trace.json";
+
+// Fold the journal into the snapshot once it grows beyond this.
+constexpr int64_t kJournalCompactBytes = 64 << 10;
+
+// Reads a line of input at row `y`, column `x` of `screen`, echoing it.
+std::string ReadLine(CursesScreen &screen, int y, int x) {
+  constexpr int kBufferLength = 64;
+  char buffer[kBufferLength];
+  WINDOW *win = screen.window();
+  nodelay(win, false);
+  echo();
+  mvwgetnstr(win, y, x, buffer, kBufferLength);
+  nodelay(win, true);
+  noecho();
+  return buffer;
+}
 
-enum Color {
-  DEFAULT = 1,
-  BAR = 2,
-  PAUSE_BAR = 3,
-  PAUSE_OVER_BAR = 4,
+// Handles a key typed in search mode, where the todo list only shows the
+// todos matching `query`. Enter and escape end the search.
+void HandleSearchKey(int ch, TodoSearch &search, std::string &query,
+                     Todo &todo) {
+  constexpr int kEscape = 27;
+  if (ch == '\n' || ch == KEY_ENTER) {
+    // Jump to the selected todo.
+    todo.ClearFilter(/*keep_selection=*/true);
+  } else if (ch == kEscape) {
+    todo.ClearFilter(/*keep_selection=*/false);
+  } else if (ch == KEY_DOWN) {
+    todo.Down();
+  } else if (ch == KEY_UP) {
+    todo.Up();
+  } else if (ch == KEY_BACKSPACE || ch == 127 || ch == '\b') {
+    if (!query.empty()) {
+      query.pop_back();
+      todo.Filter(query, search.Search(query));
+    }
+  } else if (ch >= ' ' && ch < 127) {
+    query += static_cast<char>(ch);
+    todo.Filter(query, search.Search(query));
+  }
+}
 
-  WORK_BLOCK = 5,
-  PAUSE_BLOCK = 6,
-};
+// Saves a snapshot in the background once the journal grew large, and
+// empties the journal once a snapshot containing all of it is on disk.
+void CompactJournal(const State &state, Journal &journal,
+                    PersistenceWorker &persistence) {
+  if (journal.size_bytes() == 0) {
+    return;
+  }
+  if (persistence.saved_sequence() == state.sequence()) {
+    journal.Truncate();
+  } else if (journal.size_bytes() > kJournalCompactBytes &&
+             !persistence.busy()) {
+    persistence.SaveState(state);
+  }
+}
 
-void init_colors() {
-  start_color();
-  init_pair(Color::DEFAULT, COLOR_WHITE, COLOR_BLACK);
-  init_pair(Color::BAR, COLOR_BLACK, COLOR_GREEN);
-  init_pair(Color::PAUSE_BAR, COLOR_BLACK, COLOR_BLUE);
-  init_pair(Color::PAUSE_OVER_BAR, COLOR_BLACK, COLOR_YELLOW);
+// Loads the state at `path`, parsing the history in the background.
+State LoadStateLazily(const std::string &path) {
+  PartialState partial = LoadStatePartial(path);
+  return State(std::move(partial.proto), std::move(partial.history_bytes));
+}
 
-  init_pair(Color::WORK_BLOCK, COLOR_BLACK, COLOR_GREEN);
-  init_pair(Color::PAUSE_BLOCK, COLOR_WHITE, COLOR_BLACK);
+// Maps the flat state at `flat_path` if it contains every change the state
+// at `path` does. Loads `path` otherwise, e.g. if writing the flat state
+// failed. Modification times would not tell, as they can go backwards.
+State LoadLocalState(const std::string &path, const std::string &flat_path) {
+  std::shared_ptr<const FlatState> flat = FlatState::Open(flat_path);
+  if (flat && flat->journal_sequence() >= LoadJournalSequence(path)) {
+    return State(std::move(flat));
+  }
+  return LoadStateLazily(path);
 }
 
-class Todo {
-public:
-  Todo(State &state) : state_(state) {}
+// How long startup took, printed with --timings. The flag also prints how
+// often the event loop woke up and how the saves went.
+struct Timings {
+  using Clock = std::chrono::steady_clock;
 
-  void Up() { current_item = std::max(current_item - 1, 0); }
+  bool enabled = false;
+  Clock::time_point started = Clock::now();
+  // When the state was loaded, or received from the daemon.
+  Clock::time_point state_ready;
+  std::optional<Clock::time_point> first_frame;
 
-  void Down() {
-    current_item = std::min<int>(current_item + 1, state_.todos().size() - 1);
-    current_item = std::max(current_item, 0);
+  static double Milliseconds(Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
   }
+  void Print() const {
+    if (!enabled || !first_frame) {
+      return;
+    }
+    std::cout << "Startup: state after " << Milliseconds(state_ready - started)
+              << " ms, first frame after "
+              << Milliseconds(*first_frame - started) << " ms\n";
+  }
+};
 
-  std::string CurrentTodoText() const {
-    const auto &items = state_.todos();
-    if (current_item < items.size()) {
-      return items[current_item].text;
+// The state loaded from disk, with everything that keeps it there.
+class LocalState {
+public:
+  LocalState()
+      : day_(GetDay()), state_(LoadLocalState(state_path, flat_state_path)),
+        persistence_({.state = state_path,
+                      .flat_state = flat_state_path,
+                      .todo_txt = todo_txt_path,
+                      .history_txt = todo_history_path}),
+        // Recover changes of a session that did not exit cleanly.
+        recovered_(Journal::Replay(journal_path, state_) > 0),
+        journal_(journal_path), status_page_(status_page_path) {
+    if (recovered_) {
+      persistence_.SaveState(state_);
     } else {
-      return "";
+      journal_.Truncate();
+    }
+    state_.AddObserver(&journal_);
+    if (state_.day() != day_) {
+      // Yesterday's history moves to the archive. If that fails, it stays
+      // until the next start.
+      HistoryArchive archive(archive_path);
+      if (state_.history().empty() ||
+          archive.Put(state_.day(), state_.history())) {
+        state_.ClearHistory();
+        state_.SetDay(day_);
+      }
     }
   }
 
-  void Toggle() { state_.ToggleTodo(current_item); }
+  State &state() { return state_; }
 
-  void Draw(WINDOW *win) const {
-    const auto &items = state_.todos();
-    for (int i = 0; i < items.size(); ++i) {
-      const auto &item = items[i];
-      const char status_char = item.done ? 'x' : ' ';
+  // Call after every batch of changes.
+  void Compact() {
+    TRACE_SPAN("CompactJournal");
+    CompactJournal(state_, journal_, persistence_);
+  }
 
-      attr_t attrs = 0;
-      if (i == current_item) {
-        attrs |= WA_BOLD;
-      }
-      if (item.done) {
-        attrs |= WA_DIM;
-      }
+  // Call before going to sleep.
+  void PublishStatus(const Pomodoro &pomodoro, const Todo &todo) {
+    status_page_.Publish(pomodoro.Status(), todo.CurrentTodoText());
+  }
 
-      wattron(win, attrs);
-      mvwprintw(win, i, 0, "[%c] %s", status_char, item.text.c_str());
-      wattroff(win, attrs);
+  // Books the running work, appends to the logs and saves. Prints how the
+  // saves went if `print_stats`.
+  void Close(Pomodoro &pomodoro, bool print_stats) {
+    TRACE_SPAN("LocalState::Close");
+    pomodoro.Quit();
+
+    persistence_.AppendLogs(day_, state_);
+    // Done todos are only kept in todo.txt.
+    state_.RemoveDoneTodos();
+    persistence_.SaveFinalState(state_);
+    persistence_.Flush();
+    if (persistence_.saved_sequence() == state_.sequence()) {
+      journal_.Truncate();
     }
 
-    // Move to the current item.
-    wmove(win, current_item, 1);
+    if (!print_stats) {
+      return;
+    }
+    const PersistenceWorker::Stats stats = persistence_.stats();
+    std::cout << "Saves: " << stats.written << " written, " << stats.coalesced
+              << " coalesced, last " << stats.last_latency_ms << " ms, max "
+              << stats.max_latency_ms << " ms\n";
   }
 
-  void New(WINDOW *win) {
-    current_item = 0;
-    werase(win);
-    Draw(win);
-    wrefresh(win);
+private:
+  const std::string day_;
+  State state_;
+  PersistenceWorker persistence_;
+  const bool recovered_;
+  Journal journal_;
+  StatusPageWriter status_page_;
+};
 
-    constexpr int kBufferLength = 64;
-    char buffer[kBufferLength];
-    nodelay(win, false);
-    echo();
-    mvwgetnstr(win, /*y=*/current_item, /*x=*/4, buffer, kBufferLength);
-    nodelay(win, true);
-    noecho();
-    state_.AddTodoFront(buffer);
-  }
+// Runs the terminal UI until the user quits. With a `daemon`, pomodoro
+// commands go to the daemon, and its messages update `state` and `pomodoro`.
+// Without, `local` keeps the state on disk.
+void RunUi(State &state, DaemonClient *daemon, LocalState *local,
+           Timings &timings, const std::optional<PomodoroStatus> &status) {
+  setlocale(LC_ALL, "");
+  initscr();
+  cbreak();
+  noecho();
+  keypad(stdscr, TRUE);
+  // Escape ends a search, don't wait long for an escape sequence.
+  set_escdelay(25);
 
-  void Delete() { state_.DeleteTodo(current_item); }
+  init_colors();
 
-private:
-  State &state_;
-  int current_item = 0;
-};
+  CursesScreen pomodoro_window(
+      {.nlines = 1, .ncols = 0, .begin_y = 0, .begin_x = 0});
+  CursesScreen today_window(
+      {.nlines = 1, .ncols = 0, .begin_y = 2, .begin_x = 1});
+  CursesScreen todo_window(
+      {.nlines = 0, .ncols = 0, .begin_y = 4, .begin_x = 1});
 
-class Pomodoro {
-public:
-  Pomodoro(WINDOW *window, State &state, Todo &todo)
-      : win(window), state_(state), todo_(todo) {}
-
-  // Start the next work or break unit. If work or break is already running, do
-  // nothing.
-  void Start() {
-    switch (work_state) {
-    case WORKING:
-    case PAUSE:
-      // Timer is already running. Do nothing.
-      break;
-    case WORK_DONE:
-      FinishWork();
-      work_state = PAUSE;
-      if (pomodoros_done >= 4) {
-        pomodoros_done = 0;
-        // Time for a long break, YAY!
-        timer_.Start(kLongBreakSeconds);
-      } else {
-        timer_.Start(kShortBreakSeconds);
-      }
-      break;
-    case PAUSE_DONE:
-      FinishPause();
-      work_state = WORKING;
-      timer_.Start(kWorkPhaseSeconds);
-      break;
-    }
+  Todo todo(state);
+  Pomodoro pomodoro(state, todo);
+  if (status) {
+    pomodoro.Restore(*status);
   }
-
-  void Stop() {
-    // "Force" current phase to end, so it's possible to start the next one.
-    switch (work_state) {
-    case WORKING:
-      work_state = WORK_DONE;
-      break;
-    case PAUSE:
-      work_state = PAUSE_DONE;
-      break;
-    case WORK_DONE:
-    case PAUSE_DONE:
-      // Nothing to do.
-      break;
-    }
+  TodoSearch search(state);
+  state.AddObserver(&search);
+  std::string query;
+  EventLoop loop;
+  loop.Watch(STDIN_FILENO);
+  if (daemon) {
+    loop.Watch(daemon->fd());
   }
-
-  void FinishPause() {
-    if (work_state != PAUSE_DONE || !timer_.active()) {
-      return;
+  nodelay(stdscr, TRUE);
+  // Only windows whose model changed are repainted, and all of them are
+  // flushed to the terminal at once.
+  Damage<Pomodoro::View> pomodoro_damage;
+  Damage<std::tuple<uint64_t, int, uint64_t>> todo_damage;
+  Damage<uint64_t> today_damage;
+  bool daemon_gone = false;
+  bool quit = false;
+  while (!quit) {
+    if (pomodoro.Tick()) {
+      beep();
     }
-    Done done = timer_.Stop();
-    done.set_done_type(Done::BREAK);
-    state_.AddDone(done);
-  }
 
-  void FinishWork() {
-    if (work_state != WORK_DONE) {
-      return;
+    const Pomodoro::View pomodoro_view = pomodoro.GetView(COLS);
+    if (pomodoro_damage.Update(pomodoro_view)) {
+      pomodoro_window.Erase();
+      pomodoro.Draw(pomodoro_window, pomodoro_view);
+      pomodoro_window.Present();
     }
-    pomodoros_done += 1;
-    Done done = timer_.Stop();
-    done.set_done_type(Done::WORK);
-    done.set_todo(todo_.CurrentTodoText());
-    state_.AddDone(done);
-  }
-
-  void Reset() {
-    switch (work_state) {
-    case PAUSE_DONE:
-      // Nothing to reset.
-      break;
-    case WORK_DONE:
-    case WORKING: {
-      work_state = PAUSE_DONE;
-      break;
+    if (today_damage.Update(state.history_version())) {
+      today_window.Erase();
+      DrawToday(today_window, state);
+      today_window.Present();
     }
-    case PAUSE: {
-      work_state = WORK_DONE;
-      break;
+    if (todo_damage.Update(
+            {state.todos_version(), todo.current(), todo.filter_version()})) {
+      todo_window.Erase();
+      todo.Draw(todo_window);
     }
+    // Always staged last, so the cursor ends up in the todo list.
+    todo_window.Present();
+    {
+      TRACE_SPAN("doupdate");
+      doupdate();
+    }
+    if (!timings.first_frame) {
+      timings.first_frame = Timings::Clock::now();
     }
-  }
 
-  void Tick() {
-    // timer_ automatically keeps track of time, even if the target_duration is
-    // up.
+    if (local) {
+      local->PublishStatus(pomodoro, todo);
+    }
 
-    // In case the timer *just* finished.
-    if ((work_state == WORKING || work_state == PAUSE) && timer_.IsRinging()) {
-      // We're done with the current block.
-      beep();
-      if (work_state == WORKING) {
-        work_state = WORK_DONE;
-      } else if (work_state == PAUSE) {
-        work_state = PAUSE_DONE;
+    // Sleep until a keypress, a message of the daemon or until the timer
+    // display changes.
+    const std::vector<int> ready = loop.Wait(pomodoro.NextUpdate(COLS));
+
+    if (daemon && std::find(ready.begin(), ready.end(), daemon->fd()) !=
+                      ready.end()) {
+      quit = daemon_gone = !daemon->Receive();
+      DaemonMessage message;
+      while (daemon->Next(&message)) {
+        if (message.has_mutation()) {
+          state.Apply(message.mutation());
+          search.OnMutation(message.mutation());
+          todo.ClampSelection();
+        }
+        if (message.has_status() && pomodoro.Restore(message.status())) {
+          beep();
+        }
+      }
+      if (daemon->corrupt()) {
+        quit = daemon_gone = true;
       }
     }
-  }
 
-  void Draw() const {
-    int bar_length = timer_.ElapsedFraction() * COLS;
-    bar_length = std::min(bar_length, COLS);
-    bar_length = std::max(bar_length, 1);
-    if (work_state == WORK_DONE || work_state == PAUSE_DONE) {
-      bar_length = COLS;
+    TRACE_SPAN("HandleInput");
+    for (int ch = getch(); ch != ERR && !quit; ch = getch()) {
+      if (ch == KEY_RESIZE) {
+        pomodoro_damage.Invalidate();
+        todo_damage.Invalidate();
+        today_damage.Invalidate();
+      } else if (todo.filtered()) {
+        HandleSearchKey(ch, search, query, todo);
+      } else if (ch == 'q') {
+        // Quit.
+        quit = true;
+      } else if (ch == 's') {
+        if (daemon) {
+          daemon->Send(ClientMessage::START, todo.CurrentTodoId());
+        } else {
+          pomodoro.Start();
+        }
+      } else if (ch == 'S') {
+        if (daemon) {
+          daemon->Send(ClientMessage::STOP, todo.CurrentTodoId());
+        } else {
+          pomodoro.Stop();
+        }
+      } else if (ch == 'r') {
+        if (daemon) {
+          daemon->Send(ClientMessage::RESET, todo.CurrentTodoId());
+        } else {
+          pomodoro.Reset();
+        }
+      } else if (ch == 'j' || ch == KEY_DOWN) {
+        todo.Down();
+      } else if (ch == 'k' || ch == KEY_UP) {
+        todo.Up();
+      } else if (ch == 'n') {
+        todo.MoveToTop();
+        todo_window.Erase();
+        todo.Draw(todo_window);
+        wrefresh(todo_window.window());
+        todo.New(ReadLine(todo_window, /*y=*/0, /*x=*/4));
+        todo_damage.Invalidate();
+      } else if (ch == 'D') {
+        todo.Delete();
+      } else if (ch == ' ') {
+        todo.Toggle();
+      } else if (ch == '/') {
+        query.clear();
+        todo.Filter(query, search.Search(query));
+      }
     }
 
-    const int remaining = std::lround(timer_.RemainingSeconds());
-    constexpr int kBufSize = 32;
-    char buffer[kBufSize];
-    short bar_color;
-    switch (work_state) {
-    case WORKING:
-      snprintf(buffer, kBufSize, "work %2d:%02d", remaining / 60,
-               remaining % 60);
-      bar_color = Color::BAR;
-      break;
-    case WORK_DONE: {
-      const int overtime = std::lround(timer_.OvertimeSeconds());
-      snprintf(buffer, kBufSize, "work DONE (+%d:%02d)", overtime / 60,
-               overtime % 60);
-      bar_color = Color::PAUSE_BAR;
-      break;
-    }
-    case PAUSE:
-      snprintf(buffer, kBufSize, "pause %2d:%02d", remaining / 60,
-               remaining % 60);
-      bar_color = Color::PAUSE_BAR;
-      break;
-    case PAUSE_DONE:
-      snprintf(buffer, kBufSize, "pause OVER");
-      bar_color = Color::PAUSE_OVER_BAR;
-      break;
+    if (local) {
+      local->Compact();
     }
+  }
 
-    int rows, cols;
-    getmaxyx(win, rows, cols);
-    static_cast<void>(rows);
-    const attr_t attr = 0;
-    mvwinsnstr(win, 0, 1, buffer, kBufSize);
-    mvwprintw(win, 0, cols - 2, "%1d", pomodoros_done);
-    mvwchgat(win, 0, 0, bar_length, attr, bar_color, nullptr);
+  endwin();
+  if (timings.enabled) {
+    std::cout << "Wakeups per minute: " << loop.WakeupsPerMinute() << "\n";
   }
+  if (daemon_gone) {
+    std::cout << "Lost the connection to the daemon.\n";
+  }
+  timings.Print();
+  if (local) {
+    local->Close(pomodoro, timings.enabled);
+  }
+  WriteTrace(trace_path);
+}
 
-private:
-  using Clock = std::chrono::steady_clock;
-  using TimePoint = std::chrono::time_point<Clock>;
-
-  enum WorkState {
-    WORKING,
-    WORK_DONE,
-    PAUSE,
-    PAUSE_DONE,
-  };
-
-  WINDOW *win;
-  State &state_;
-  Todo &todo_;
-  PomodoroTimer timer_;
-  WorkState work_state = PAUSE_DONE;
-  int pomodoros_done = 0;
+// `cprd daemon`: keeps the state and the timer for cprd clients until
+// SIGINT or SIGTERM.
+int RunDaemon() {
+  if (DaemonClient::Connect(socket_path)) {
+    std::cout << "A daemon is already running.\n";
+    return 1;
+  }
+  const int listen_fd = ListenUnix(socket_path);
+  if (listen_fd < 0) {
+    std::cout << "Could not listen on '" << socket_path << "'.\n";
+    return 1;
+  }
+  // Signals are handled in the event loop.
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, nullptr);
+  const int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+  LocalState local;
+  Todo todo(local.state());
+  Pomodoro pomodoro(local.state(), todo);
+  EventLoop loop;
+  loop.Watch(signal_fd);
+  Daemon daemon(listen_fd, local.state(), todo, pomodoro, loop);
+  local.state().AddObserver(&daemon);
+  bool quit = false;
+  while (!quit) {
+    const std::optional<Timer::TimePoint> next_tick = daemon.Tick();
+    local.PublishStatus(pomodoro, todo);
+    const std::vector<int> ready = loop.Wait(next_tick);
+    quit = std::find(ready.begin(), ready.end(), signal_fd) != ready.end();
+    daemon.Handle(ready);
+    local.Compact();
+  }
+  close(signal_fd);
+  unlink(socket_path);
+  local.Close(pomodoro, /*print_stats=*/false);
+  WriteTrace(trace_path);
+  return 0;
+}
+
+// The days that `cprd report` and `cprd stats` cover, and the current day,
+// which is not archived yet.
+struct HistoryRange {
+  // Days since 1970-01-01.
+  int first;
+  int last;
+  // The state with the current day's history, loaded as cprd does.
+  State current;
+  // The current day if it is within the range.
+  std::optional<int> current_day;
 };
 
-std::string GetDay() {
-  char buf[sizeof "2021-04-19"];
-  time_t now;
-  time(&now);
-  strftime(buf, sizeof buf, "%F", localtime(&now));
-  return std::string(buf);
+// Reads the range from `argv` as `cprd <command> [first [last]]`, by default
+// the last four weeks. Prints the usage and returns nothing if it is invalid.
+std::optional<HistoryRange> LoadHistoryRange(int argc, char **argv) {
+  const std::optional<int> today = ParseDay(GetDay());
+  const std::optional<int> first =
+      argc > 2 ? ParseDay(argv[2]) : std::optional<int>(*today - 27);
+  const std::optional<int> last = argc > 3 ? ParseDay(argv[3]) : today;
+  if (!first || !last) {
+    std::cout << "Usage: cprd " << argv[1] << " [YYYY-MM-DD [YYYY-MM-DD]]\n";
+    return std::nullopt;
+  }
+
+  State current = LoadLocalState(state_path, flat_state_path);
+  Journal::Replay(journal_path, current);
+  std::optional<int> current_day = ParseDay(current.day());
+  if (current_day && (*current_day < *first || *current_day > *last)) {
+    current_day.reset();
+  }
+  return HistoryRange{.first = *first,
+                      .last = *last,
+                      .current = std::move(current),
+                      .current_day = current_day};
 }
 
-void SaveTodo(const std::string &day, const std::vector<State::Todo> &items) {
-  std::ofstream os(todo_txt_path, std::ios_base::app);
-  if (!os.is_open()) {
-    std::cout << "Could not write to '" << todo_txt_path << "'.\n";
-    return;
+// `cprd report [first [last]]`: prints worked time per day, week and todo
+// for the days from `first` to `last`, by default the last four weeks.
+int RunReport(int argc, char **argv) {
+  const std::optional<HistoryRange> range = LoadHistoryRange(argc, argv);
+  if (!range) {
+    return 1;
   }
 
-  os << "\n";
-  os << day << "\n";
-  for (const State::Todo &item : items) {
-    char done_indicator = item.done ? 'x' : ' ';
-    os << " " << done_indicator << " " << item.text << "\n";
+  const HistoryArchive archive(archive_path);
+  Report report = BuildReport(archive, range->first, range->last,
+                              std::thread::hardware_concurrency());
+  if (range->current_day) {
+    for (const Done &done : range->current.history()) {
+      report.Add(*range->current_day, done);
+    }
   }
+
+  PrintReport(std::cout, report);
+  return 0;
 }
 
-void SaveTodayTxt(const State &state) {
-  std::ofstream os(todo_history_path, std::ios_base::app);
-  if (!os.is_open()) {
-    std::cout << "Could not write to '" << todo_history_path << "'.\n";
-    return;
+// `cprd stats [first [last]]`: prints pomodoros, overtime and breaks per day
+// for the days from `first` to `last`, by default the last four weeks.
+int RunStats(int argc, char **argv) {
+  const std::optional<HistoryRange> range = LoadHistoryRange(argc, argv);
+  if (!range) {
+    return 1;
   }
 
-  os << "\n" << state.day() << "\n";
-  for (const Done &done : state.history()) {
-    if (done.done_type() != Done::WORK)
-      continue;
-    const int duration_minutes = std::lround(done.duration_seconds() / 60);
-    os << "  " << done.start_time() << " " << done.end_time() << " "
-       << duration_minutes << "m " << done.todo() << "\n";
+  HistoryColumns columns;
+  for (const TodayHistoryProto &history :
+       HistoryArchive(archive_path).RangeByNumber(range->first, range->last)) {
+    columns.Append(history);
+  }
+  if (range->current_day) {
+    for (const Done &done : range->current.history()) {
+      columns.Append(*range->current_day, done);
+    }
   }
-}
 
-StateProto LoadState() {
-  StateProto state;
-  std::ifstream is(state_path, std::ios::binary);
-  state.ParseFromIstream(&is);
-  return state;
+  PrintHistoryStats(std::cout, columns, kWorkPhaseSeconds);
+  return 0;
 }
 
-void SaveState(const StateProto &state_proto) {
-  std::ofstream os(state_path, std::ios::binary);
-  state_proto.SerializeToOstream(&os);
+// `cprd import`: moves the days logged in todo.txt and todo.history.txt into
+// the archive, e.g. those from before the archive existed.
+int RunImport() {
+  HistoryArchive archive(archive_path);
+  const ImportStats stats =
+      ImportLogs(todo_txt_path, todo_history_path, *ParseDay(GetDay()),
+                 archive, std::thread::hardware_concurrency());
+  std::cout << "Imported " << stats.days << " days with " << stats.todos
+            << " todos and " << stats.work << " work blocks from "
+            << stats.bytes << " bytes.\n";
+  return 0;
 }
 
-class NCursesWindow {
-public:
-  WINDOW *window;
-  struct Args {
-    int nlines;
-    int ncols;
-    int begin_y;
-    int begin_x;
-  };
-
-  explicit NCursesWindow(Args args)
-      : window(newwin(args.nlines, args.ncols, args.begin_y, args.begin_x)) {}
-  ~NCursesWindow() { delwin(window); }
-
-  void Erase() { werase(window); }
-  void Refresh() { wrefresh(window); }
-};
+// `cprd simulate [days]`: runs the default day script on a simulated clock and
+// checks that every fourth work block is followed by a long break.
+int RunSimulate(int argc, char **argv) {
+  const int days = argc > 2 ? std::atoi(argv[2]) : 7 * 52;
+  if (days <= 0) {
+    std::cout << "Usage: cprd simulate [days]\n";
+    return 1;
+  }
+  const SimulationStats stats = Simulate(kDefaultDayScript, days);
+  PrintSimulation(std::cout, stats);
+  return stats.wrong_breaks == 0 ? 0 : 1;
+}
 
-void DrawToday(WINDOW *win, const State &state) {
-  for (const Done &phase : state.history()) {
-    const int64_t duration_minutes = std::lround(phase.duration_seconds() / 60);
+// `cprd team [shards]`: hosts the pomodoros of many users until interrupted.
+int RunTeamServer(int argc, char **argv) {
+  const int shards =
+      argc > 2 ? std::atoi(argv[2])
+               : std::max(1u, std::thread::hardware_concurrency());
+  const int listen_fd = ListenUnix(team_socket_path);
+  if (listen_fd < 0) {
+    std::cout << "Could not listen on '" << team_socket_path << "'.\n";
+    return 1;
+  }
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  sigprocmask(SIG_BLOCK, &signals, nullptr);
+  const int signal_fd = signalfd(-1, &signals, SFD_CLOEXEC);
+
+  TeamServer::Stats stats;
+  {
+    TeamServer server(listen_fd, team_directory, shards);
+    server.Run(signal_fd);
+    stats = server.stats();
+  }
+  close(signal_fd);
+  unlink(team_socket_path);
+  WriteTrace(trace_path);
+  std::cout << "Served " << stats.requests << " requests of " << stats.users
+            << " users.\n";
+  return 0;
+}
 
-    if (phase.done_type() == Done::WORK) {
-      wcolor_set(win, Color::WORK_BLOCK, NULL);
-    } else if (phase.done_type() == Done::BREAK) {
-      wcolor_set(win, Color::PAUSE_BLOCK, NULL);
-    }
-    wprintw(win, " %d ", duration_minutes);
+// `cprd team-load [users [seconds]]`: runs simulated users against
+// `cprd team`.
+int RunLoadGenerator(int argc, char **argv) {
+  TeamLoadOptions options;
+  options.socket_path = team_socket_path;
+  if (argc > 2) {
+    options.users = std::atoi(argv[2]);
+  }
+  if (argc > 3) {
+    options.duration = std::chrono::seconds(std::atoi(argv[3]));
+  }
+  const std::optional<TeamLoadResult> result = RunTeamLoad(options);
+  if (!result) {
+    std::cout << "Could not reach the team server at '" << team_socket_path
+              << "'.\n";
+    return 1;
   }
+  PrintTeamLoad(std::cout, *result);
+  return 0;
 }
 
-int main() {
+int main(int argc, char **argv) {
   GOOGLE_PROTOBUF_VERIFY_VERSION;
-  const std::string day = GetDay();
-  State state(LoadState());
-  if (state.day() != day) {
-    state.ClearHistory();
-    state.SetDay(day);
+  if (argc > 1 && std::string_view(argv[1]) == "report") {
+    return RunReport(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "stats") {
+    return RunStats(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "import") {
+    return RunImport();
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "simulate") {
+    return RunSimulate(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "team") {
+    return RunTeamServer(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "team-load") {
+    return RunLoadGenerator(argc, argv);
+  }
+  if (argc > 1 && std::string_view(argv[1]) == "daemon") {
+    return RunDaemon();
   }
 
-  setlocale(LC_ALL, "");
-  initscr();
-  cbreak();
-  noecho();
-  keypad(stdscr, TRUE);
-
-  init_colors();
-
-  NCursesWindow pomodoro_window(
-      {.nlines = 1, .ncols = 0, .begin_y = 0, .begin_x = 0});
-  NCursesWindow today_window(
-      {.nlines = 1, .ncols = 0, .begin_y = 2, .begin_x = 1});
-  NCursesWindow todo_window(
-      {.nlines = 0, .ncols = 0, .begin_y = 4, .begin_x = 1});
-
-  Todo todo(state);
-  Pomodoro pomodoro(pomodoro_window.window, state, todo);
-  nodelay(stdscr, TRUE);
-  for (;;) {
-    int ch = getch();
-    if (ch == ERR) {
-      // No keypress.
-      std::this_thread::sleep_for(std::chrono::milliseconds(20));
-    } else if (ch == 'q') {
-      // Quit.
-      break;
-    } else if (ch == 's') {
-      pomodoro.Start();
-    } else if (ch == 'S') {
-      pomodoro.Stop();
-    } else if (ch == 'r') {
-      pomodoro.Reset();
-    } else if (ch == 'j' || ch == KEY_DOWN) {
-      todo.Down();
-    } else if (ch == 'k' || ch == KEY_UP) {
-      todo.Up();
-    } else if (ch == 'n') {
-      todo.New(todo_window.window);
-    } else if (ch == 'D') {
-      todo.Delete();
-    } else if (ch == ' ') {
-      todo.Toggle();
+  Timings timings;
+  timings.enabled = argc > 1 && std::string_view(argv[1]) == "--timings";
+
+  // Attach to the daemon if one is running.
+  if (std::unique_ptr<DaemonClient> daemon =
+          DaemonClient::Connect(socket_path)) {
+    std::optional<DaemonMessage> snapshot =
+        daemon->WaitForMessage(std::chrono::seconds(5));
+    if (!snapshot || !snapshot->has_state()) {
+      std::cout << "The daemon at '" << socket_path << "' did not answer.\n";
+      return 1;
     }
-
-    pomodoro.Tick();
-
-    pomodoro_window.Erase();
-    todo_window.Erase();
-    today_window.Erase();
-    pomodoro.Draw();
-    todo.Draw(todo_window.window);
-    DrawToday(today_window.window, state);
-    pomodoro_window.Refresh();
-    today_window.Refresh();
-    todo_window.Refresh();
+    State state(std::move(*snapshot->mutable_state()));
+    state.set_remote(daemon.get());
+    timings.state_ready = Timings::Clock::now();
+    RunUi(state, daemon.get(), /*local=*/nullptr, timings, snapshot->status());
+    return 0;
   }
 
-  endwin();
-
-  pomodoro.FinishWork();
-
-  SaveState(state.ToProto());
-  SaveTodo(day, state.todos());
-  SaveTodayTxt(state);
+  LocalState local;
+  timings.state_ready = Timings::Clock::now();
+  RunUi(local.state(), /*daemon=*/nullptr, &local, timings, std::nullopt);
 }
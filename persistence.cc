@@ -0,0 +1,130 @@
+#include "persistence.h"
+
+#include <chrono>
+#include <utility>
+
+#include "storage.h"
+
+namespace {
+
+std::shared_ptr<const State> Snapshot(const State &state) {
+  auto snapshot = std::make_shared<State>(state);
+  snapshot->ClearObservers();
+  return snapshot;
+}
+
+} // namespace
+
+PersistenceWorker::PersistenceWorker(Paths paths)
+    : paths_(std::move(paths)), thread_([this] { Run(); }) {}
+
+PersistenceWorker::~PersistenceWorker() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stopping_ = true;
+  }
+  wake_.notify_one();
+  thread_.join();
+}
+
+void PersistenceWorker::SaveState(const State &state) {
+  QueueState(state, false);
+}
+
+void PersistenceWorker::SaveFinalState(const State &state) {
+  QueueState(state, true);
+}
+
+void PersistenceWorker::QueueState(const State &state, bool flat) {
+  std::shared_ptr<const State> snapshot = Snapshot(state);
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (pending_state_) {
+      ++stats_.coalesced;
+    }
+    pending_state_ = std::move(snapshot);
+    // A coalesced final save still needs its flat copy.
+    pending_flat_ = pending_flat_ || flat;
+    ++stats_.requested;
+  }
+  wake_.notify_one();
+}
+
+void PersistenceWorker::AppendLogs(const std::string &day,
+                                   const State &state) {
+  LogJob job = {.day = day, .state = Snapshot(state)};
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    pending_logs_.push_back(std::move(job));
+    ++stats_.requested;
+  }
+  wake_.notify_one();
+}
+
+void PersistenceWorker::Flush() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  idle_.wait(lock, [this] { return QueueDepthLocked() == 0 && !writing_; });
+}
+
+bool PersistenceWorker::busy() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return QueueDepthLocked() > 0 || writing_;
+}
+
+uint64_t PersistenceWorker::saved_sequence() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return saved_sequence_;
+}
+
+PersistenceWorker::Stats PersistenceWorker::stats() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  Stats stats = stats_;
+  stats.queue_depth = QueueDepthLocked();
+  return stats;
+}
+
+void PersistenceWorker::Run() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  for (;;) {
+    wake_.wait(lock, [this] { return stopping_ || QueueDepthLocked() > 0; });
+    if (QueueDepthLocked() == 0) {
+      // Stopping and everything is written.
+      return;
+    }
+
+    std::shared_ptr<const State> state = std::move(pending_state_);
+    pending_state_.reset();
+    const bool flat = std::exchange(pending_flat_, false);
+    std::deque<LogJob> logs;
+    logs.swap(pending_logs_);
+    writing_ = true;
+    lock.unlock();
+
+    const auto start = std::chrono::steady_clock::now();
+    bool state_saved = false;
+    if (state) {
+      state_saved = ::SaveState(paths_.state, *state) &&
+                    (!flat || paths_.flat_state.empty() ||
+                     SaveFlatState(paths_.flat_state, *state));
+    }
+    for (const LogJob &job : logs) {
+      SaveTodo(paths_.todo_txt, job.day, job.state->todos());
+      SaveTodayTxt(paths_.history_txt, *job.state);
+    }
+    const std::chrono::duration<double, std::milli> latency =
+        std::chrono::steady_clock::now() - start;
+
+    lock.lock();
+    writing_ = false;
+    if (state_saved) {
+      saved_sequence_ = state->sequence();
+    }
+    stats_.written += (state ? 1 : 0) + logs.size();
+    stats_.last_latency_ms = latency.count();
+    stats_.max_latency_ms = std::max(stats_.max_latency_ms, latency.count());
+    stats_.total_latency_ms += latency.count();
+    if (QueueDepthLocked() == 0) {
+      idle_.notify_all();
+    }
+  }
+}
@@ -0,0 +1,91 @@
+#ifndef POMODORO_PERSISTENCE_H_
+#define POMODORO_PERSISTENCE_H_
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "state.h"
+
+// Writes State to disk on a background thread, so a slow disk never stalls
+// the timer or the input loop. Callers hand over an immutable copy of the
+// state. Snapshot saves are coalesced: while one is being written, later
+// requests replace each other and only the newest one is written.
+class PersistenceWorker {
+public:
+  struct Paths {
+    std::string state;
+    // A flat copy of the state, written after `state` by SaveFinalState().
+    // Empty for none.
+    std::string flat_state;
+    std::string todo_txt;
+    std::string history_txt;
+  };
+
+  struct Stats {
+    // Jobs waiting to be written.
+    int queue_depth = 0;
+    int64_t requested = 0;
+    int64_t written = 0;
+    // Snapshot requests replaced by a newer one before being written.
+    int64_t coalesced = 0;
+    double last_latency_ms = 0;
+    double max_latency_ms = 0;
+    double total_latency_ms = 0;
+  };
+
+  explicit PersistenceWorker(Paths paths);
+  // Writes all pending jobs before returning.
+  ~PersistenceWorker();
+  PersistenceWorker(const PersistenceWorker &) = delete;
+  PersistenceWorker &operator=(const PersistenceWorker &) = delete;
+
+  // Replaces the snapshot file with the current state.
+  void SaveState(const State &state);
+  // Like SaveState(), and also replaces the flat copy, which only the next
+  // start reads. Other saves leave the flat copy behind the snapshot, and the
+  // next start then does not use it, so saves during a session write once.
+  void SaveFinalState(const State &state);
+  // Appends the todo list and today's work to the human-readable logs.
+  void AppendLogs(const std::string &day, const State &state);
+  // Blocks until all jobs requested so far are written.
+  void Flush();
+
+  // Whether a job is pending or being written.
+  bool busy() const;
+  // State::sequence() of the newest snapshot that made it to disk.
+  uint64_t saved_sequence() const;
+  Stats stats() const;
+
+private:
+  struct LogJob {
+    std::string day;
+    std::shared_ptr<const State> state;
+  };
+
+  void QueueState(const State &state, bool flat);
+  void Run();
+  int QueueDepthLocked() const {
+    return (pending_state_ ? 1 : 0) + pending_logs_.size();
+  }
+
+  const Paths paths_;
+  mutable std::mutex mutex_;
+  std::condition_variable wake_;
+  std::condition_variable idle_;
+  std::shared_ptr<const State> pending_state_;
+  // Whether pending_state_ also goes to the flat copy.
+  bool pending_flat_ = false;
+  std::deque<LogJob> pending_logs_;
+  bool writing_ = false;
+  bool stopping_ = false;
+  uint64_t saved_sequence_ = 0;
+  Stats stats_;
+  std::thread thread_;
+};
+
+#endif // POMODORO_PERSISTENCE_H_
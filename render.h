@@ -0,0 +1,29 @@
+#ifndef POMODORO_RENDER_H_
+#define POMODORO_RENDER_H_
+
+// Remembers what was last drawn into a window, so that the window is only
+// erased and repainted when the model behind it changed.
+template <typename Key> class Damage {
+public:
+  // Returns true if `key` differs from the last drawn one, i.e. the window
+  // needs to be repainted.
+  bool Update(const Key &key) {
+    if (valid_ && last_ == key) {
+      return false;
+    }
+    last_ = key;
+    valid_ = true;
+    return true;
+  }
+
+  // Forces a repaint, e.g. after the terminal was resized.
+  void Invalidate() { valid_ = false; }
+
+private:
+  // Not std::optional, whose payload GCC takes for uninitialized when
+  // comparing tuples.
+  bool valid_ = false;
+  Key last_{};
+};
+
+#endif // POMODORO_RENDER_H_
@@ -0,0 +1,144 @@
+#include "report.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <functional>
+#include <iomanip>
+#include <optional>
+#include <thread>
+#include <vector>
+
+#include "time_utils.h"
+
+namespace {
+
+int MondayOf(int day_number) {
+  const std::chrono::weekday weekday{
+      std::chrono::sys_days{std::chrono::days{day_number}}};
+  return day_number - (weekday.iso_encoding() - 1);
+}
+
+void PrintRow(std::ostream &os, const std::string &label,
+              const ReportTotals &totals) {
+  os << "  " << std::left << std::setw(24) << label << std::right
+     << std::setw(6) << std::lround(totals.work_seconds / 60) << " min"
+     << std::setw(5) << totals.pomodoros << " pomodoros" << std::setw(6)
+     << std::lround(totals.break_seconds / 60) << " min break ("
+     << std::lround(totals.BreakRatio() * 100) << "%)\n";
+}
+
+} // namespace
+
+void ReportTotals::Add(const Done &done) {
+  if (done.done_type() == Done::WORK) {
+    work_seconds += done.duration_seconds();
+    ++pomodoros;
+  } else if (done.done_type() == Done::BREAK) {
+    // Dones without a type count as neither.
+    break_seconds += done.duration_seconds();
+    ++breaks;
+  }
+}
+
+void ReportTotals::Merge(const ReportTotals &other) {
+  work_seconds += other.work_seconds;
+  break_seconds += other.break_seconds;
+  pomodoros += other.pomodoros;
+  breaks += other.breaks;
+}
+
+void Report::Add(int day_number, const Done &done) {
+  days[day_number].Add(done);
+  weeks[MondayOf(day_number)].Add(done);
+  if (done.done_type() == Done::WORK) {
+    todos[done.todo()].Add(done);
+  }
+  total.Add(done);
+}
+
+void Report::Merge(const Report &other) {
+  for (const auto &[day, totals] : other.days) {
+    days[day].Merge(totals);
+  }
+  for (const auto &[week, totals] : other.weeks) {
+    weeks[week].Merge(totals);
+  }
+  for (const auto &[todo, totals] : other.todos) {
+    todos[todo].Merge(totals);
+  }
+  total.Merge(other.total);
+}
+
+Report BuildReport(const HistoryArchive &archive, int first, int last,
+                   int threads, int chunk_days) {
+  first = std::max(first, 0);
+  chunk_days = std::max(chunk_days, 1);
+  if (last < first) {
+    return {};
+  }
+  const int chunks = (last - first) / chunk_days + 1;
+  threads = std::clamp(threads, 1, chunks);
+
+  // Threads take the next chunk until none are left, so a few busy days do
+  // not hold up the others.
+  std::atomic<int> next_chunk = 0;
+  std::vector<Report> reports(threads);
+  const auto summarize = [&](Report &report) {
+    for (int chunk = next_chunk++; chunk < chunks; chunk = next_chunk++) {
+      const int chunk_first = first + chunk * chunk_days;
+      const int chunk_last = std::min(last, chunk_first + chunk_days - 1);
+      for (const TodayHistoryProto &day :
+           archive.RangeByNumber(chunk_first, chunk_last)) {
+        const std::optional<int> day_number = ParseDay(day.day());
+        if (!day_number) {
+          continue;
+        }
+        for (const Done &done : day.done()) {
+          report.Add(*day_number, done);
+        }
+      }
+    }
+  };
+
+  std::vector<std::thread> workers;
+  for (int i = 1; i < threads; ++i) {
+    workers.emplace_back(summarize, std::ref(reports[i]));
+  }
+  summarize(reports[0]);
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+  for (int i = 1; i < threads; ++i) {
+    reports[0].Merge(reports[i]);
+  }
+  return std::move(reports[0]);
+}
+
+void PrintReport(std::ostream &os, const Report &report) {
+  os << "Days\n";
+  for (const auto &[day, totals] : report.days) {
+    PrintRow(os, FormatDay(day), totals);
+  }
+  os << "Weeks\n";
+  for (const auto &[week, totals] : report.weeks) {
+    PrintRow(os, "week of " + FormatDay(week), totals);
+  }
+
+  // Most worked on todos first.
+  std::vector<std::pair<const std::string *, const ReportTotals *>> todos;
+  for (const auto &[todo, totals] : report.todos) {
+    todos.emplace_back(&todo, &totals);
+  }
+  std::sort(todos.begin(), todos.end(), [](const auto &a, const auto &b) {
+    return a.second->work_seconds > b.second->work_seconds;
+  });
+  os << "Todos\n";
+  for (const auto &[todo, totals] : todos) {
+    PrintRow(os, todo->empty() ? "(no todo)" : todo->substr(0, 24), *totals);
+  }
+
+  os << "Total\n";
+  PrintRow(os, "", report.total);
+}
@@ -0,0 +1,49 @@
+#ifndef POMODORO_REPORT_H_
+#define POMODORO_REPORT_H_
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+
+#include "archive.h"
+#include "state.pb.h"
+
+// Time spent in work and break blocks.
+struct ReportTotals {
+  double work_seconds = 0;
+  double break_seconds = 0;
+  int64_t pomodoros = 0;
+  int64_t breaks = 0;
+
+  void Add(const Done &done);
+  void Merge(const ReportTotals &other);
+  // Break time per work time, 0 without work.
+  double BreakRatio() const {
+    return work_seconds > 0 ? break_seconds / work_seconds : 0;
+  }
+};
+
+// Totals per day, per Monday-to-Sunday week and per todo text. Memory grows
+// with the number of days and distinct todos, not with the number of blocks.
+struct Report {
+  // Keyed by days since 1970-01-01, weeks by their Monday.
+  std::map<int, ReportTotals> days;
+  std::map<int, ReportTotals> weeks;
+  std::map<std::string, ReportTotals> todos;
+  ReportTotals total;
+
+  void Add(int day_number, const Done &done);
+  void Merge(const Report &other);
+};
+
+// Summarizes the archived days from `first` to `last` (days since
+// 1970-01-01), inclusive. The range is cut into chunks of `chunk_days` days,
+// which `threads` threads read and summarize in parallel, so only one chunk
+// per thread is in memory at a time.
+Report BuildReport(const HistoryArchive &archive, int first, int last,
+                   int threads, int chunk_days = 64);
+
+void PrintReport(std::ostream &os, const Report &report);
+
+#endif // POMODORO_REPORT_H_
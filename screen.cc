@@ -0,0 +1,101 @@
+#include "screen.h"
+
+#include <algorithm>
+
+namespace {
+
+// Rough sizes of the escape sequences a terminal update needs.
+constexpr int kCursorMoveBytes = 8;   // "\e[12;34H"
+constexpr int kStyleChangeBytes = 12; // "\e[0;1;30;42m"
+
+} // namespace
+
+MemoryScreen::MemoryScreen(int rows, int cols)
+    : rows_(rows), cols_(cols), cells_(rows * cols), presented_(rows * cols) {}
+
+void MemoryScreen::Erase() {
+  std::fill(cells_.begin(), cells_.end(), Cell());
+  cursor_y_ = 0;
+  cursor_x_ = 0;
+}
+
+void MemoryScreen::Print(int y, int x, std::string_view text, Style style) {
+  if (y < 0 || y >= rows_ || x < 0 || x >= cols_) {
+    return;
+  }
+  Move(y, x);
+  Append(text, style);
+}
+
+void MemoryScreen::Append(std::string_view text, Style style) {
+  for (const char ch : text) {
+    if (cursor_y_ >= rows_) {
+      return;
+    }
+    cells_[cursor_y_ * cols_ + cursor_x_] = {.ch = ch, .style = style};
+    if (++cursor_x_ == cols_) {
+      if (cursor_y_ + 1 == rows_) {
+        // Like ncurses, the cursor stays in the bottom right cell.
+        cursor_x_ = cols_ - 1;
+        return;
+      }
+      cursor_x_ = 0;
+      ++cursor_y_;
+    }
+  }
+}
+
+void MemoryScreen::ChangeStyle(int y, int x, int n, Style style) {
+  if (y < 0 || y >= rows_ || x < 0) {
+    return;
+  }
+  const int end = std::min(x + n, cols_);
+  for (int i = x; i < end; ++i) {
+    cells_[y * cols_ + i].style = style;
+  }
+}
+
+void MemoryScreen::Move(int y, int x) {
+  if (y < 0 || y >= rows_ || x < 0 || x >= cols_) {
+    return;
+  }
+  cursor_y_ = y;
+  cursor_x_ = x;
+}
+
+void MemoryScreen::Present() {
+  int64_t bytes = 0;
+  for (int y = 0; y < rows_; ++y) {
+    bool in_run = false;
+    Style style;
+    for (int x = 0; x < cols_; ++x) {
+      const int i = y * cols_ + x;
+      if (cells_[i] == presented_[i]) {
+        in_run = false;
+        continue;
+      }
+      if (!in_run) {
+        bytes += kCursorMoveBytes;
+        in_run = true;
+        bytes += kStyleChangeBytes;
+        style = cells_[i].style;
+      } else if (!(cells_[i].style == style)) {
+        bytes += kStyleChangeBytes;
+        style = cells_[i].style;
+      }
+      bytes += 1;
+    }
+  }
+  presented_ = cells_;
+  ++frames_;
+  last_frame_bytes_ = bytes;
+  total_bytes_ += bytes;
+}
+
+std::string MemoryScreen::Row(int y) const {
+  std::string row(cols_, ' ');
+  for (int x = 0; x < cols_; ++x) {
+    row[x] = At(y, x).ch;
+  }
+  return row;
+}
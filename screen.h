@@ -0,0 +1,92 @@
+#ifndef POMODORO_SCREEN_H_
+#define POMODORO_SCREEN_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// How text is drawn: attribute bits and a color pair number.
+struct Style {
+  enum Attribute : uint8_t {
+    kBold = 1 << 0,
+    kDim = 1 << 1,
+  };
+
+  uint8_t attributes = 0;
+  short color = 0;
+
+  bool operator==(const Style &) const = default;
+};
+
+// A rectangular window the draw code writes into. Text that runs past the
+// right edge wraps into the next row, like in ncurses. Printing at or moving
+// to a position outside the window does nothing.
+class Screen {
+public:
+  virtual ~Screen() = default;
+
+  virtual int rows() const = 0;
+  virtual int cols() const = 0;
+
+  // Clears all cells and moves the cursor to the top left.
+  virtual void Erase() = 0;
+  // Writes `text` at row `y`, column `x` and leaves the cursor after it.
+  virtual void Print(int y, int x, std::string_view text, Style style) = 0;
+  // Writes `text` at the cursor.
+  virtual void Append(std::string_view text, Style style) = 0;
+  // Restyles `n` cells starting at row `y`, column `x`, keeping their text.
+  virtual void ChangeStyle(int y, int x, int n, Style style) = 0;
+  virtual void Move(int y, int x) = 0;
+  // Hands the window contents to the terminal. Nothing is visible before.
+  virtual void Present() = 0;
+};
+
+// A Screen that only keeps a grid of cells in memory, for rendering without a
+// terminal. Present() compares the grid against the previously presented one
+// and estimates how many bytes a terminal update would take.
+class MemoryScreen : public Screen {
+public:
+  struct Cell {
+    char ch = ' ';
+    Style style;
+
+    bool operator==(const Cell &) const = default;
+  };
+
+  MemoryScreen(int rows, int cols);
+
+  int rows() const override { return rows_; }
+  int cols() const override { return cols_; }
+
+  void Erase() override;
+  void Print(int y, int x, std::string_view text, Style style) override;
+  void Append(std::string_view text, Style style) override;
+  void ChangeStyle(int y, int x, int n, Style style) override;
+  void Move(int y, int x) override;
+  void Present() override;
+
+  const Cell &At(int y, int x) const { return cells_[y * cols_ + x]; }
+  // The text of row `y`, including trailing blanks.
+  std::string Row(int y) const;
+  int cursor_y() const { return cursor_y_; }
+  int cursor_x() const { return cursor_x_; }
+
+  int64_t frames() const { return frames_; }
+  // Estimated terminal output of the last and of all Present() calls.
+  int64_t last_frame_bytes() const { return last_frame_bytes_; }
+  int64_t total_bytes() const { return total_bytes_; }
+
+private:
+  int rows_;
+  int cols_;
+  std::vector<Cell> cells_;
+  std::vector<Cell> presented_;
+  int cursor_y_ = 0;
+  int cursor_x_ = 0;
+  int64_t frames_ = 0;
+  int64_t last_frame_bytes_ = 0;
+  int64_t total_bytes_ = 0;
+};
+
+#endif // POMODORO_SCREEN_H_
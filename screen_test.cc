@@ -0,0 +1,159 @@
+#include "screen.h"
+
+#include "gtest/gtest.h"
+#include "state.h"
+#include "state.pb.h"
+#include "ui.h"
+
+namespace {
+
+// Estimated terminal output, as MemoryScreen::Present() counts it.
+constexpr int kCursorMoveBytes = 8;
+constexpr int kStyleChangeBytes = 12;
+
+TEST(MemoryScreenTest, PrintsAndCountsBytes) {
+  MemoryScreen screen(2, 10);
+  screen.Print(0, 2, "abc", Style());
+  EXPECT_EQ(screen.Row(0), "  abc     ");
+  EXPECT_EQ(screen.Row(1), "          ");
+  EXPECT_EQ(screen.cursor_y(), 0);
+  EXPECT_EQ(screen.cursor_x(), 5);
+
+  screen.Present();
+  EXPECT_EQ(screen.last_frame_bytes(),
+            kCursorMoveBytes + kStyleChangeBytes + 3);
+
+  // An unchanged frame costs nothing.
+  screen.Erase();
+  screen.Print(0, 2, "abc", Style());
+  screen.Present();
+  EXPECT_EQ(screen.last_frame_bytes(), 0);
+  EXPECT_EQ(screen.frames(), 2);
+  EXPECT_EQ(screen.total_bytes(), kCursorMoveBytes + kStyleChangeBytes + 3);
+}
+
+TEST(MemoryScreenTest, OnlyChangedCellsAreSent) {
+  MemoryScreen screen(1, 10);
+  screen.Print(0, 0, "0123456789", Style());
+  screen.Present();
+
+  screen.Erase();
+  screen.Print(0, 0, "0x23456y89", Style());
+  screen.Present();
+  // Two runs of one cell each.
+  EXPECT_EQ(screen.last_frame_bytes(),
+            2 * (kCursorMoveBytes + kStyleChangeBytes + 1));
+}
+
+TEST(MemoryScreenTest, WrapsAndStopsAtTheBottomRight) {
+  MemoryScreen screen(2, 4);
+  screen.Print(0, 2, "abcdefgh", Style());
+  EXPECT_EQ(screen.Row(0), "  ab");
+  EXPECT_EQ(screen.Row(1), "cdef");
+  EXPECT_EQ(screen.cursor_y(), 1);
+  EXPECT_EQ(screen.cursor_x(), 3);
+
+  // Positions outside the window are ignored.
+  screen.Print(2, 0, "x", Style());
+  screen.Print(0, 4, "x", Style());
+  EXPECT_EQ(screen.Row(0), "  ab");
+}
+
+TEST(MemoryScreenTest, ChangeStyleKeepsText) {
+  MemoryScreen screen(1, 6);
+  screen.Print(0, 0, "abcdef", Style());
+  screen.ChangeStyle(0, 4, 10, {.attributes = Style::kBold, .color = 3});
+  EXPECT_EQ(screen.Row(0), "abcdef");
+  EXPECT_EQ(screen.At(0, 3).style, Style());
+  EXPECT_EQ(screen.At(0, 4).style,
+            (Style{.attributes = Style::kBold, .color = 3}));
+  EXPECT_EQ(screen.At(0, 5).style.color, 3);
+
+  screen.Present();
+  EXPECT_EQ(screen.last_frame_bytes(),
+            kCursorMoveBytes + 2 * kStyleChangeBytes + 6);
+}
+
+TEST(MemoryScreenTest, DrawsToday) {
+  StateProto proto;
+  proto.mutable_history()->set_day("2021-04-19");
+  State state(proto);
+  Done work;
+  work.set_done_type(Done::WORK);
+  work.set_duration_seconds(25 * 60);
+  Done pause;
+  pause.set_done_type(Done::BREAK);
+  pause.set_duration_seconds(5 * 60);
+  state.AddDone(work);
+  state.AddDone(pause);
+  state.AddDone(work);
+
+  MemoryScreen screen(1, 16);
+  DrawToday(screen, state);
+  screen.Present();
+
+  EXPECT_EQ(screen.Row(0), " 25  5  25      ");
+  for (int x = 0; x < 11; ++x) {
+    const bool in_pause = x >= 4 && x < 7;
+    EXPECT_EQ(screen.At(0, x).style.color,
+              in_pause ? Color::PAUSE_BLOCK : Color::WORK_BLOCK)
+        << "column " << x;
+  }
+  EXPECT_EQ(screen.At(0, 11).style, Style());
+  // One run with three styles.
+  EXPECT_EQ(screen.last_frame_bytes(),
+            kCursorMoveBytes + 3 * kStyleChangeBytes + 11);
+
+  screen.Erase();
+  DrawToday(screen, state);
+  screen.Present();
+  EXPECT_EQ(screen.last_frame_bytes(), 0);
+}
+
+TEST(MemoryScreenTest, CutsTodosBetweenCharacters) {
+  StateProto proto;
+  // "ä" and "€" take two and three bytes.
+  proto.add_todo_item()->set_text("abc\xc3\xa4");
+  proto.add_todo_item()->set_text("a\xe2\x82\xac");
+  proto.add_todo_item()->set_text("ab\xc3\xa4");
+  State state(std::move(proto));
+  Todo todo(state);
+
+  MemoryScreen screen(3, 8);
+  todo.Draw(screen);
+  EXPECT_EQ(screen.Row(0), "[ ] abc ");
+  EXPECT_EQ(screen.Row(1), "[ ] a\xe2\x82\xac");
+  EXPECT_EQ(screen.Row(2), "[ ] ab\xc3\xa4");
+
+  MemoryScreen narrow(3, 7);
+  todo.Draw(narrow);
+  EXPECT_EQ(narrow.Row(0), "[ ] abc");
+  EXPECT_EQ(narrow.Row(1), "[ ] a  ");
+  EXPECT_EQ(narrow.Row(2), "[ ] ab ");
+}
+
+TEST(MemoryScreenTest, DrawsThePomodoro) {
+  State state(StateProto{});
+  Todo todo(state);
+  Pomodoro pomodoro(state, todo);
+  const Pomodoro::View view = {.text = "work 24:59",
+                               .bar_length = 5,
+                               .bar_color = Color::BAR,
+                               .pomodoros_done = 2};
+
+  MemoryScreen screen(1, 20);
+  pomodoro.Draw(screen, view);
+  screen.Present();
+
+  EXPECT_EQ(screen.Row(0), " work 24:59       2 ");
+  for (int x = 0; x < 20; ++x) {
+    EXPECT_EQ(screen.At(0, x).style.color, x < 5 ? Color::BAR : 0)
+        << "column " << x;
+  }
+  // The blank after "work" is unchanged and splits the text into two runs.
+  // The count is a third.
+  EXPECT_EQ(screen.last_frame_bytes(),
+            3 * (kCursorMoveBytes + kStyleChangeBytes) + 5 + 5 + 1);
+}
+
+} // namespace
@@ -0,0 +1,204 @@
+#include "search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <utility>
+
+namespace {
+
+char Lower(char c) {
+  return static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+}
+
+std::string ToLower(std::string_view text) {
+  std::string lower(text);
+  for (char &c : lower) {
+    c = Lower(c);
+  }
+  return lower;
+}
+
+uint32_t Trigram(std::string_view text, size_t pos) {
+  return static_cast<uint8_t>(text[pos]) << 16 |
+         static_cast<uint8_t>(text[pos + 1]) << 8 |
+         static_cast<uint8_t>(text[pos + 2]);
+}
+
+// Distinct trigrams of an already lower-cased `text`.
+std::vector<uint32_t> Trigrams(std::string_view text) {
+  std::vector<uint32_t> trigrams;
+  for (size_t pos = 0; pos + 3 <= text.size(); ++pos) {
+    trigrams.push_back(Trigram(text, pos));
+  }
+  std::sort(trigrams.begin(), trigrams.end());
+  trigrams.erase(std::unique(trigrams.begin(), trigrams.end()),
+                 trigrams.end());
+  return trigrams;
+}
+
+std::vector<std::string> Words(std::string_view query) {
+  std::vector<std::string> words;
+  size_t pos = 0;
+  while (pos < query.size()) {
+    const size_t end = std::min(query.find(' ', pos), query.size());
+    if (end > pos) {
+      words.push_back(ToLower(query.substr(pos, end - pos)));
+    }
+    pos = end + 1;
+  }
+  return words;
+}
+
+// Whether `text` contains all of the lower-case `words`, ignoring case.
+bool Matches(std::string_view text, const std::vector<std::string> &words) {
+  for (const std::string &word : words) {
+    const auto it = std::search(
+        text.begin(), text.end(), word.begin(), word.end(),
+        [](char a, char b) { return Lower(a) == b; });
+    if (it == text.end() && !word.empty()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace
+
+TodoSearch::TodoSearch(const State &state) : state_(state) { Rebuild(); }
+
+void TodoSearch::OnMutation(const Mutation &mutation) {
+  switch (mutation.change_case()) {
+  case Mutation::kAddTodo:
+    Add(mutation.todo_id(), mutation.add_todo());
+    break;
+  case Mutation::kAddTodoFront:
+    Add(mutation.todo_id(), mutation.add_todo_front());
+    break;
+  case Mutation::kDeleteTodoId:
+    Remove(mutation.delete_todo_id());
+    break;
+  case Mutation::kDeleteTodo:
+  case Mutation::kRemoveDoneTodos:
+    // The removed todos are no longer known.
+    Rebuild();
+    break;
+  case Mutation::kToggleTodo:
+  case Mutation::kToggleTodoId:
+  case Mutation::kAddDone:
+  case Mutation::kSetDay:
+  case Mutation::kClearHistory:
+  case Mutation::CHANGE_NOT_SET:
+    // Texts did not change.
+    return;
+  }
+  cache_valid_ = false;
+}
+
+std::vector<uint64_t> TodoSearch::Search(std::string_view query) {
+  const std::vector<std::string> words = Words(query);
+  std::vector<uint64_t> results;
+
+  if (cache_valid_ && query.starts_with(last_query_)) {
+    // Every match of the extended query also matched the previous one.
+    for (const uint64_t id : last_results_) {
+      const auto it = texts_.find(id);
+      if (it != texts_.end() && Matches(it->second, words)) {
+        results.push_back(id);
+      }
+    }
+  } else if (std::any_of(words.begin(), words.end(),
+                         [](const std::string &w) { return w.size() >= 3; })) {
+    // Results come in ID order and are sorted into list order.
+    std::vector<std::pair<size_t, uint64_t>> positions;
+    const TodoList &todos = state_.todos();
+    for (const uint64_t id : Candidates(words)) {
+      if (Matches(texts_.at(id), words)) {
+        positions.emplace_back(todos.PositionOf(id).value_or(0), id);
+      }
+    }
+    std::sort(positions.begin(), positions.end());
+    results.reserve(positions.size());
+    for (const auto &[position, id] : positions) {
+      results.push_back(id);
+    }
+  } else {
+    // Too short for trigrams, check every todo in list order.
+    for (const TodoItem &item : state_.todos()) {
+      if (Matches(item.text, words)) {
+        results.push_back(item.id);
+      }
+    }
+  }
+
+  cache_valid_ = true;
+  last_query_ = std::string(query);
+  last_results_ = results;
+  return results;
+}
+
+void TodoSearch::Add(uint64_t id, const std::string &text) {
+  std::string lower = ToLower(text);
+  for (const uint32_t trigram : Trigrams(lower)) {
+    std::vector<uint64_t> &ids = postings_[trigram];
+    // New todos have the largest IDs so far, so this is almost always an
+    // append.
+    ids.insert(std::upper_bound(ids.begin(), ids.end(), id), id);
+  }
+  texts_[id] = std::move(lower);
+}
+
+void TodoSearch::Remove(uint64_t id) {
+  const auto it = texts_.find(id);
+  if (it == texts_.end()) {
+    return;
+  }
+  for (const uint32_t trigram : Trigrams(it->second)) {
+    const auto posting = postings_.find(trigram);
+    if (posting == postings_.end()) {
+      continue;
+    }
+    std::vector<uint64_t> &ids = posting->second;
+    const auto pos = std::lower_bound(ids.begin(), ids.end(), id);
+    if (pos != ids.end() && *pos == id) {
+      ids.erase(pos);
+    }
+    if (ids.empty()) {
+      postings_.erase(posting);
+    }
+  }
+  texts_.erase(it);
+}
+
+void TodoSearch::Rebuild() {
+  texts_.clear();
+  postings_.clear();
+  for (const TodoItem &item : state_.todos()) {
+    Add(item.id, item.text);
+  }
+  cache_valid_ = false;
+}
+
+std::vector<uint64_t>
+TodoSearch::Candidates(const std::vector<std::string> &words) const {
+  std::vector<const std::vector<uint64_t> *> lists;
+  for (const std::string &word : words) {
+    for (const uint32_t trigram : Trigrams(word)) {
+      const auto it = postings_.find(trigram);
+      if (it == postings_.end()) {
+        return {};
+      }
+      lists.push_back(&it->second);
+    }
+  }
+  // Intersect starting with the shortest list.
+  std::sort(lists.begin(), lists.end(),
+            [](const auto *a, const auto *b) { return a->size() < b->size(); });
+  std::vector<uint64_t> candidates = *lists.front();
+  for (size_t i = 1; i < lists.size() && !candidates.empty(); ++i) {
+    const std::vector<uint64_t> &list = *lists[i];
+    std::erase_if(candidates, [&](uint64_t id) {
+      return !std::binary_search(list.begin(), list.end(), id);
+    });
+  }
+  return candidates;
+}
@@ -0,0 +1,52 @@
+#ifndef POMODORO_SEARCH_H_
+#define POMODORO_SEARCH_H_
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+#include "state.h"
+#include "state.pb.h"
+
+// Finds todos by text, ignoring case. A todo matches if it contains every
+// space-separated word of the query.
+//
+// Keeps a trigram index over all todos, updated as State changes: each
+// trigram maps to the sorted IDs of the todos containing it. Words of three
+// or more characters only look at the todos in the intersection of their
+// trigrams' lists. Extending the previous query, as happens with every typed
+// character, only re-checks the previous results.
+class TodoSearch : public State::Observer {
+public:
+  // Indexes the current todos of `state`. Add as an observer of `state` to
+  // keep the index up to date.
+  explicit TodoSearch(const State &state);
+
+  void OnMutation(const Mutation &mutation) override;
+
+  // IDs of the matching todos in list order. An empty query matches all.
+  std::vector<uint64_t> Search(std::string_view query);
+
+  int64_t indexed_trigrams() const { return postings_.size(); }
+
+private:
+  void Add(uint64_t id, const std::string &text);
+  void Remove(uint64_t id);
+  void Rebuild();
+  // Candidate IDs for `words` in ascending ID order, from the posting lists.
+  std::vector<uint64_t> Candidates(const std::vector<std::string> &words) const;
+
+  const State &state_;
+  // Lower-case text of every todo.
+  std::unordered_map<uint64_t, std::string> texts_;
+  std::unordered_map<uint32_t, std::vector<uint64_t>> postings_;
+
+  // The previous query and its results, while the todos did not change.
+  bool cache_valid_ = false;
+  std::string last_query_;
+  std::vector<uint64_t> last_results_;
+};
+
+#endif // POMODORO_SEARCH_H_
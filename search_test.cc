@@ -0,0 +1,188 @@
+#include "search.h"
+
+#include <algorithm>
+#include <cctype>
+#include <random>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "screen.h"
+#include "state.h"
+#include "state.pb.h"
+#include "ui.h"
+
+namespace {
+
+std::string ToLower(std::string_view text) {
+  std::string lower(text);
+  for (char &c : lower) {
+    c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+  }
+  return lower;
+}
+
+// What TodoSearch::Search() should return, by checking every todo.
+std::vector<uint64_t> SearchAll(const State &state, std::string_view query) {
+  std::vector<std::string> words;
+  for (size_t pos = 0; pos <= query.size();) {
+    const size_t end = std::min(query.find(' ', pos), query.size());
+    if (end > pos) {
+      words.push_back(ToLower(query.substr(pos, end - pos)));
+    }
+    pos = end + 1;
+  }
+  std::vector<uint64_t> ids;
+  for (const TodoItem &item : state.todos()) {
+    const std::string text = ToLower(item.text);
+    if (std::all_of(words.begin(), words.end(), [&](const std::string &word) {
+          return text.find(word) != std::string::npos;
+        })) {
+      ids.push_back(item.id);
+    }
+  }
+  return ids;
+}
+
+State MakeState(const std::vector<std::string> &texts) {
+  StateProto proto;
+  for (const std::string &text : texts) {
+    proto.add_todo_item()->set_text(text);
+  }
+  return State(std::move(proto));
+}
+
+TEST(TodoSearchTest, FindsTodosWithEveryWordInListOrder) {
+  State state = MakeState({"Write report", "read Mail", "Report bug",
+                           "mail the REPORT", "Lunch"});
+  TodoSearch search(state);
+  const auto id = [&](int position) { return state.todos()[position].id; };
+
+  EXPECT_EQ(search.Search("report"), (std::vector{id(0), id(2), id(3)}));
+  EXPECT_EQ(search.Search("mail report"), (std::vector{id(3)}));
+  EXPECT_EQ(search.Search("  MAIL  "), (std::vector{id(1), id(3)}));
+  // Too short for trigrams.
+  EXPECT_EQ(search.Search("bu"), (std::vector{id(2)}));
+  EXPECT_EQ(search.Search("nothing"), std::vector<uint64_t>());
+  EXPECT_EQ(search.Search("").size(), 5u);
+}
+
+TEST(TodoSearchTest, TypingReusesResultsOnlyWhileTodosDoNotChange) {
+  State state = MakeState({"project plan", "prototype", "lunch"});
+  TodoSearch search(state);
+  state.AddObserver(&search);
+
+  EXPECT_EQ(search.Search("pro").size(), 2u);
+  EXPECT_EQ(search.Search("proj").size(), 1u);
+  // Added after the previous results, so they must not be reused.
+  state.AddTodo("project review");
+  EXPECT_EQ(search.Search("proje"), SearchAll(state, "proje"));
+  state.AddTodoFront("projection");
+  EXPECT_EQ(search.Search("projec"), SearchAll(state, "projec"));
+  state.DeleteTodo(*state.todos().PositionOf(search.Search("projec")[0]));
+  EXPECT_EQ(search.Search("project"), SearchAll(state, "project"));
+  EXPECT_EQ(search.Search("project").size(), 2u);
+}
+
+TEST(TodoSearchTest, MatchesCheckingEveryTodoWhileTypingAndEditing) {
+  const std::vector<std::string> words = {"Plan", "review", "mail", "BUG",
+                                          "fix",  "a",      "ab",   "Lunch"};
+  std::mt19937 random(1);
+  const auto text = [&] {
+    std::string text;
+    for (int i = random() % 4; i >= 0; --i) {
+      text += words[random() % words.size()] + (random() % 3 ? " " : "");
+    }
+    return text;
+  };
+
+  State state = MakeState({});
+  TodoSearch search(state);
+  state.AddObserver(&search);
+  std::string query;
+  for (int step = 0; step < 5000; ++step) {
+    switch (random() % 8) {
+    case 0:
+      state.AddTodo(text());
+      break;
+    case 1:
+      state.AddTodoFront(text());
+      break;
+    case 2:
+      if (!state.todos().empty()) {
+        state.DeleteTodo(random() % state.todos().size());
+      }
+      break;
+    case 3:
+      if (!state.todos().empty()) {
+        state.ToggleTodo(random() % state.todos().size());
+      }
+      break;
+    case 4:
+      query.clear();
+      break;
+    case 5:
+      if (!query.empty()) {
+        query.pop_back();
+      }
+      break;
+    default: {
+      // Typing a character of some todo text.
+      const std::string next = text();
+      query += next[random() % next.size()];
+      break;
+    }
+    }
+    ASSERT_EQ(search.Search(query), SearchAll(state, query))
+        << "step " << step << ", query '" << query << "'";
+  }
+}
+
+TEST(TodoFilterTest, DeletedTodosLeaveNoBlankRows) {
+  State state =
+      MakeState({"task one", "lunch", "task two", "task three", "task four"});
+  TodoSearch search(state);
+  state.AddObserver(&search);
+  Todo todo(state);
+  todo.Filter("task", search.Search("task"));
+  todo.Down();
+  todo.Down();
+  ASSERT_EQ(todo.CurrentTodoText(), "task three");
+
+  // Deleted by another client, while the filter still has its ID.
+  state.DeleteTodo(*state.todos().PositionOf(search.Search("two")[0]));
+  MemoryScreen screen(5, 16);
+  todo.Draw(screen);
+  EXPECT_EQ(screen.Row(0), "/task           ");
+  EXPECT_EQ(screen.Row(1), "[ ] task one    ");
+  EXPECT_EQ(screen.Row(2), "[ ] task three  ");
+  EXPECT_EQ(screen.Row(3), "[ ] task four   ");
+  EXPECT_EQ(screen.Row(4), "                ");
+  EXPECT_EQ(todo.CurrentTodoText(), "task three");
+  EXPECT_EQ(todo.current(), 1);
+}
+
+TEST(TodoFilterTest, SelectionMovesOnWhenItsTodoIsDeleted) {
+  State state = MakeState({"task one", "task two", "task three"});
+  Todo todo(state);
+  TodoSearch search(state);
+  todo.Filter("task", search.Search("task"));
+  const uint64_t filter_version = todo.filter_version();
+  todo.Down();
+
+  state.DeleteTodo(1);
+  todo.ClampSelection();
+  EXPECT_EQ(todo.CurrentTodoText(), "task three");
+  EXPECT_NE(todo.filter_version(), filter_version);
+
+  state.DeleteTodo(1);
+  todo.ClampSelection();
+  EXPECT_EQ(todo.CurrentTodoText(), "task one");
+  state.DeleteTodo(0);
+  todo.ClampSelection();
+  EXPECT_EQ(todo.CurrentTodoText(), "");
+  EXPECT_EQ(todo.current(), 0);
+}
+
+} // namespace
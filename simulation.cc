@@ -0,0 +1,110 @@
+#include "simulation.h"
+
+#include <chrono>
+#include <cmath>
+
+#include "state.h"
+#include "state.pb.h"
+#include "time_utils.h"
+#include "ui.h"
+
+namespace {
+
+constexpr int64_t kFirstDayUs = 1618819200000000; // 2021-04-19 08:00 UTC.
+
+// Counts the work blocks the pomodoro records, independently of its own
+// counter.
+class WorkCounter : public State::Observer {
+public:
+  void OnMutation(const Mutation &mutation) override {
+    if (mutation.has_add_done() &&
+        mutation.add_done().done_type() == Done::WORK) {
+      ++since_long_break;
+      ++total;
+    }
+  }
+
+  int64_t since_long_break = 0;
+  int64_t total = 0;
+};
+
+} // namespace
+
+SimulationStats Simulate(std::string_view day_script, int days) {
+  const std::chrono::system_clock::time_point first_day{
+      std::chrono::microseconds(kFirstDayUs)};
+  const int first_day_number =
+      std::chrono::floor<std::chrono::days>(first_day).time_since_epoch().count();
+  SimulatedClock clock(first_day);
+  State state{StateProto()};
+  WorkCounter counter;
+  state.AddObserver(&counter);
+  Todo todo(state);
+  todo.New("Simulate");
+  Pomodoro pomodoro(state, todo, clock);
+
+  SimulationStats stats;
+  for (int day = 0; day < days; ++day) {
+    // The simulated steady clock starts at zero on the first day.
+    clock.AdvanceTo(Timer::TimePoint(std::chrono::days(day)));
+    state.ClearHistory();
+    state.SetDay(FormatDay(first_day_number + day));
+
+    for (const char step : day_script) {
+      switch (step) {
+      case 's': {
+        const bool was_pause = pomodoro.Status().work_state() ==
+                               PomodoroStatus::WORK_DONE;
+        pomodoro.Start();
+        if (!was_pause) {
+          break;
+        }
+        const bool is_long =
+            pomodoro.Status().target_duration_seconds() == kLongBreakSeconds;
+        if (is_long != (counter.since_long_break >= 4)) {
+          ++stats.wrong_breaks;
+        }
+        if (is_long) {
+          ++stats.long_breaks;
+          counter.since_long_break = 0;
+        } else {
+          ++stats.short_breaks;
+        }
+        break;
+      }
+      case 'x':
+        pomodoro.Stop();
+        break;
+      case 'r':
+        pomodoro.Reset();
+        break;
+      case 'w':
+        if (const std::optional<Timer::TimePoint> ring = pomodoro.RingTime()) {
+          clock.AdvanceTo(*ring);
+        }
+        pomodoro.Tick();
+        break;
+      case 'm':
+        clock.Advance(std::chrono::minutes(1));
+        pomodoro.Tick();
+        break;
+      default:
+        continue;
+      }
+      ++stats.steps;
+    }
+    ++stats.days;
+  }
+  stats.work_blocks = counter.total;
+  stats.simulated_seconds =
+      std::chrono::duration<double>(clock.SystemNow() - first_day).count();
+  return stats;
+}
+
+void PrintSimulation(std::ostream &os, const SimulationStats &stats) {
+  os << "Simulated " << stats.days << " days ("
+     << std::lround(stats.simulated_seconds / 3600) << " hours) in "
+     << stats.steps << " steps: " << stats.work_blocks << " work blocks, "
+     << stats.short_breaks << " short breaks, " << stats.long_breaks
+     << " long breaks, " << stats.wrong_breaks << " wrong breaks.\n";
+}
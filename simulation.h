@@ -0,0 +1,40 @@
+#ifndef POMODORO_SIMULATION_H_
+#define POMODORO_SIMULATION_H_
+
+#include <cstdint>
+#include <ostream>
+#include <string_view>
+
+// A scripted day has one character per step:
+//   s  Start()
+//   x  Stop()
+//   r  Reset()
+//   w  wait until the running block rings, then Tick()
+//   m  wait a minute, then Tick()
+// Everything else is ignored, so scripts can be spaced out for reading.
+//
+// Ten pomodoros, one of them stopped early and one reset.
+constexpr std::string_view kDefaultDayScript =
+    "swsw swsw swsw swsw smmmxsw swsw smr swsw swsw swsw swsw m";
+
+struct SimulationStats {
+  int64_t days = 0;
+  int64_t steps = 0;
+  int64_t work_blocks = 0;
+  int64_t short_breaks = 0;
+  int64_t long_breaks = 0;
+  double simulated_seconds = 0;
+  // Breaks that were long or short, but the work blocks recorded since the
+  // last long break called for the other kind.
+  int64_t wrong_breaks = 0;
+};
+
+// Runs `day_script` on each of `days` days, starting 2021-04-19 at 08:00 UTC.
+// The clock jumps straight to the next ring instead of waiting for it, so this
+// runs as fast as the Pomodoro state machine does. Every day starts with an
+// empty history; the pomodoro itself carries over.
+SimulationStats Simulate(std::string_view day_script, int days);
+
+void PrintSimulation(std::ostream &os, const SimulationStats &stats);
+
+#endif // POMODORO_SIMULATION_H_
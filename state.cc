@@ -1,34 +1,522 @@
 #include "state.h"
 
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "google/protobuf/wire_format_lite.h"
 #include "state.pb.h"
+#include "time_utils.h"
+
+namespace {
 
-State::State(const StateProto &proto) : day_(proto.history().day()) {
+std::vector<Done> ParseHistory(const std::string &day,
+                               const std::string &history_bytes) {
+  TodayHistoryProto history;
+  history.ParseFromString(history_bytes);
+  std::vector<Done> dones;
+  dones.reserve(history.done_size());
+  for (Done &done : *history.mutable_done()) {
+    // Both live on the heap, so moving swaps instead of copying.
+    dones.push_back(std::move(done));
+    UpgradeDoneTimes(day, &dones.back());
+  }
+  return dones;
+}
+
+} // namespace
+
+State::State(StateProto proto, std::string history_bytes)
+    : day_(proto.history().day()),
+      next_todo_id_(std::max<uint64_t>(proto.next_todo_id(), 1)),
+      sequence_(proto.journal_sequence()) {
+  if (proto.has_pomodoro()) {
+    pomodoro_ = proto.pomodoro();
+  }
+  for (const TodoProto &todo : proto.todo_item()) {
+    next_todo_id_ = std::max(next_todo_id_, todo.id() + 1);
+  }
+  for (TodoProto &todo : *proto.mutable_todo_item()) {
+    // Files written before todos had IDs.
+    const uint64_t id = todo.has_id() ? todo.id() : next_todo_id_++;
+    todos_.PushBack({.id = id,
+                     .done = todo.done(),
+                     .text = std::move(*todo.mutable_text())});
+  }
+  // Files written before todo_item existed.
   for (const std::string &todo_descr : proto.todo()) {
-    AddTodo(todo_descr);
+    todos_.PushBack({.id = next_todo_id_++, .done = false, .text = todo_descr});
+  }
+  if (todos_.empty()) {
+    todos_.PushBack(
+        {.id = next_todo_id_++, .done = false, .text = "Make TODO list"});
+  }
+
+  history_.reserve(proto.history().done_size());
+  for (Done &done : *proto.mutable_history()->mutable_done()) {
+    history_.push_back(std::move(done));
+    UpgradeDoneTimes(day_, &history_.back());
+  }
+  if (history_bytes.empty()) {
+    for (const Done &done : history_) {
+      phases_.push_back({done.done_type(), done.duration_seconds()});
+    }
+    return;
+  }
+
+  const TodaySummaryProto &summary = proto.today_summary();
+  if (!proto.has_today_summary() ||
+      summary.done_type_size() != summary.duration_seconds_size()) {
+    // Files written before the summary existed.
+    for (Done &done : ParseHistory(day_, history_bytes)) {
+      history_.push_back(std::move(done));
+    }
+    for (const Done &done : history_) {
+      phases_.push_back({done.done_type(), done.duration_seconds()});
+    }
+    return;
+  }
+  for (int i = 0; i < summary.done_type_size(); ++i) {
+    phases_.push_back({static_cast<Done::DoneType>(summary.done_type(i)),
+                       summary.duration_seconds(i)});
+  }
+  pending_history_ =
+      std::async(std::launch::async,
+                 [day = day_, bytes = std::move(history_bytes)] {
+                   return ParseHistory(day, bytes);
+                 })
+          .share();
+}
+
+State::State(std::shared_ptr<const FlatState> flat)
+    : day_(flat->day()),
+      next_todo_id_(std::max<uint64_t>(flat->next_todo_id(), 1)),
+      pomodoro_(flat->pomodoro()), sequence_(flat->journal_sequence()) {
+  for (int i = 0; i < flat->todo_count(); ++i) {
+    const FlatState::Todo todo = flat->todo(i);
+    todos_.PushBack(
+        {.id = todo.id, .done = todo.done, .text = std::string(todo.text)});
+    next_todo_id_ = std::max(next_todo_id_, todo.id + 1);
   }
   if (todos_.empty()) {
-    AddTodo("Make TODO list");
+    todos_.PushBack(
+        {.id = next_todo_id_++, .done = false, .text = "Make TODO list"});
+  }
+  phases_.reserve(flat->phases().size());
+  for (const FlatPhase &phase : flat->phases()) {
+    phases_.push_back(
+        {static_cast<Done::DoneType>(phase.type), phase.duration_seconds});
+  }
+  if (flat->done_count() > 0) {
+    mapped_history_ = std::move(flat);
   }
+}
 
-  for (const Done &done : proto.history().done()) {
-    history_.push_back(done);
+void State::WaitForHistory() const {
+  if (mapped_history_) {
+    history_.reserve(history_.size() + mapped_history_->done_count());
+    for (int i = 0; i < mapped_history_->done_count(); ++i) {
+      history_.push_back(mapped_history_->done(i));
+    }
+    mapped_history_.reset();
+  }
+  if (!pending_history_.valid()) {
+    return;
   }
+  const std::vector<Done> &parsed = pending_history_.get();
+  history_.insert(history_.end(), parsed.begin(), parsed.end());
+  pending_history_ = {};
 }
 
 StateProto State::ToProto() const {
   StateProto proto;
-  proto.mutable_history()->set_day(day_);
+  proto.set_journal_sequence(sequence_);
+  proto.set_next_todo_id(next_todo_id_);
 
   for (const Todo &todo : todos_) {
-    if (!todo.done) {
-      proto.add_todo(todo.text);
+    TodoProto *todo_proto = proto.add_todo_item();
+    todo_proto->set_id(todo.id);
+    todo_proto->set_text(todo.text);
+    if (todo.done) {
+      todo_proto->set_done(true);
     }
   }
 
   proto.mutable_history()->set_day(day_);
-  for (const Done &done : history_) {
+  for (const Done &done : history()) {
     *proto.mutable_history()->add_done() = done;
   }
+  TodaySummaryProto *summary = proto.mutable_today_summary();
+  for (const Phase &phase : phases_) {
+    summary->add_done_type(phase.type);
+    summary->add_duration_seconds(phase.duration_seconds);
+  }
+  if (pomodoro_) {
+    *proto.mutable_pomodoro() = *pomodoro_;
+  }
 
   return proto;
 }
+
+void State::SerializeTo(google::protobuf::io::CodedOutputStream *output) const {
+  using google::protobuf::internal::WireFormatLite;
+  // Submessages are preceded by their size, so sizes are added up first.
+  // Done::ByteSizeLong() caches the size for SerializeWithCachedSizes().
+  // Fields are written in order of their numbers, as protobuf does.
+  const auto tag = [](int field, WireFormatLite::WireType type) {
+    return WireFormatLite::MakeTag(field, type);
+  };
+  constexpr auto kLengthDelimited = WireFormatLite::WIRETYPE_LENGTH_DELIMITED;
+
+  size_t history_size = 1 + WireFormatLite::StringSize(day_);
+  for (const Done &done : history()) {
+    history_size +=
+        1 + WireFormatLite::LengthDelimitedSize(done.ByteSizeLong());
+  }
+  output->WriteTag(tag(StateProto::kHistoryFieldNumber, kLengthDelimited));
+  output->WriteVarint64(history_size);
+  WireFormatLite::WriteString(TodayHistoryProto::kDayFieldNumber, day_, output);
+  for (const Done &done : history()) {
+    output->WriteTag(
+        tag(TodayHistoryProto::kDoneFieldNumber, kLengthDelimited));
+    output->WriteVarint32(done.GetCachedSize());
+    done.SerializeWithCachedSizes(output);
+  }
+
+  WireFormatLite::WriteUInt64(StateProto::kJournalSequenceFieldNumber,
+                              sequence_, output);
+
+  for (const Todo &todo : todos_) {
+    const size_t todo_size = 1 + WireFormatLite::StringSize(todo.text) +
+                             (todo.done ? 2 : 0) + 1 +
+                             WireFormatLite::UInt64Size(todo.id);
+    output->WriteTag(tag(StateProto::kTodoItemFieldNumber, kLengthDelimited));
+    output->WriteVarint64(todo_size);
+    WireFormatLite::WriteString(TodoProto::kTextFieldNumber, todo.text, output);
+    if (todo.done) {
+      WireFormatLite::WriteBool(TodoProto::kDoneFieldNumber, true, output);
+    }
+    WireFormatLite::WriteUInt64(TodoProto::kIdFieldNumber, todo.id, output);
+  }
+
+  WireFormatLite::WriteUInt64(StateProto::kNextTodoIdFieldNumber,
+                              next_todo_id_, output);
+
+  // Both fields of the summary are packed.
+  size_t types_size = 0;
+  for (const Phase &phase : phases_) {
+    types_size += WireFormatLite::Int32Size(phase.type);
+  }
+  const size_t durations_size =
+      phases_.size() * WireFormatLite::kDoubleSize;
+  size_t summary_size = 0;
+  if (!phases_.empty()) {
+    summary_size = 1 + WireFormatLite::LengthDelimitedSize(types_size) + 1 +
+                   WireFormatLite::LengthDelimitedSize(durations_size);
+  }
+  output->WriteTag(
+      tag(StateProto::kTodaySummaryFieldNumber, kLengthDelimited));
+  output->WriteVarint64(summary_size);
+  if (!phases_.empty()) {
+    output->WriteTag(
+        tag(TodaySummaryProto::kDoneTypeFieldNumber, kLengthDelimited));
+    output->WriteVarint64(types_size);
+    for (const Phase &phase : phases_) {
+      WireFormatLite::WriteInt32NoTag(phase.type, output);
+    }
+    output->WriteTag(
+        tag(TodaySummaryProto::kDurationSecondsFieldNumber, kLengthDelimited));
+    output->WriteVarint64(durations_size);
+    for (const Phase &phase : phases_) {
+      WireFormatLite::WriteDoubleNoTag(phase.duration_seconds, output);
+    }
+  }
+
+  if (pomodoro_) {
+    output->WriteTag(tag(StateProto::kPomodoroFieldNumber, kLengthDelimited));
+    output->WriteVarint32(pomodoro_->ByteSizeLong());
+    pomodoro_->SerializeWithCachedSizes(output);
+  }
+}
+
+bool State::SerializeFlatTo(
+    google::protobuf::io::CodedOutputStream *output) const {
+  const std::vector<Done> &dones = history();
+  const std::string pomodoro =
+      pomodoro_ ? pomodoro_->SerializeAsString() : std::string();
+  uint64_t strings_size = day_.size() + pomodoro.size();
+  for (const Todo &todo : todos_) {
+    strings_size += todo.text.size();
+  }
+  for (const Done &done : dones) {
+    strings_size +=
+        done.todo().size() + done.start_time().size() + done.end_time().size();
+  }
+  if (strings_size > std::numeric_limits<uint32_t>::max()) {
+    return false;
+  }
+
+  // Sections and strings are laid out in the order they are written.
+  uint64_t offset = sizeof(FlatHeader);
+  const auto section = [&](uint64_t count, size_t element_size) {
+    const FlatSection result = {.offset = offset, .count = count};
+    offset += count * element_size;
+    return result;
+  };
+  uint32_t string_offset = 0;
+  const auto pooled = [&](const std::string &string) {
+    const FlatString result = {.offset = string_offset,
+                               .size = static_cast<uint32_t>(string.size())};
+    string_offset += string.size();
+    return result;
+  };
+  const auto write = [&](const auto &record) {
+    output->WriteRaw(&record, sizeof record);
+  };
+
+  // Initializers are evaluated in order, so the sections follow each other.
+  const FlatHeader header = {
+      .magic = FlatHeader::kMagic,
+      .version = FlatHeader::kVersion,
+      .padding = 0,
+      .journal_sequence = sequence_,
+      .next_todo_id = next_todo_id_,
+      .day = pooled(day_),
+      .pomodoro = pooled(pomodoro),
+      .todos = section(todos_.size(), sizeof(FlatTodo)),
+      .phases = section(phases_.size(), sizeof(FlatPhase)),
+      .dones = section(dones.size(), sizeof(FlatDone)),
+      .strings = section(strings_size, 1)};
+  write(header);
+
+  for (const Todo &todo : todos_) {
+    write(FlatTodo{.id = todo.id,
+                   .text = pooled(todo.text),
+                   .done = todo.done,
+                   .padding = 0});
+  }
+  for (const Phase &phase : phases_) {
+    write(FlatPhase{.type = phase.type,
+                    .padding = 0,
+                    .duration_seconds = phase.duration_seconds});
+  }
+  for (const Done &done : dones) {
+    FlatDone record = {.start_time_us = done.start_time_us(),
+                       .end_time_us = done.end_time_us(),
+                       .duration_seconds = done.duration_seconds(),
+                       .todo_id = done.todo_id(),
+                       .todo = pooled(done.todo()),
+                       .start_time = pooled(done.start_time()),
+                       .end_time = pooled(done.end_time()),
+                       .done_type = done.done_type(),
+                       .utc_offset_seconds = done.utc_offset_seconds(),
+                       .has_bits = 0,
+                       .padding = 0};
+    const std::pair<int, bool> fields[] = {
+        {Done::kDoneTypeFieldNumber, done.has_done_type()},
+        {Done::kStartTimeFieldNumber, done.has_start_time()},
+        {Done::kEndTimeFieldNumber, done.has_end_time()},
+        {Done::kTodoFieldNumber, done.has_todo()},
+        {Done::kDurationSecondsFieldNumber, done.has_duration_seconds()},
+        {Done::kStartTimeUsFieldNumber, done.has_start_time_us()},
+        {Done::kEndTimeUsFieldNumber, done.has_end_time_us()},
+        {Done::kUtcOffsetSecondsFieldNumber, done.has_utc_offset_seconds()},
+        {Done::kTodoIdFieldNumber, done.has_todo_id()},
+    };
+    for (const auto &[field, has] : fields) {
+      record.has_bits |= uint32_t{has} << field;
+    }
+    write(record);
+  }
+
+  output->WriteString(day_);
+  output->WriteString(pomodoro);
+  for (const Todo &todo : todos_) {
+    output->WriteString(todo.text);
+  }
+  for (const Done &done : dones) {
+    output->WriteString(done.todo());
+    output->WriteString(done.start_time());
+    output->WriteString(done.end_time());
+  }
+  return true;
+}
+
+uint64_t State::AddTodo(const std::string &text) {
+  const uint64_t id = next_todo_id_;
+  Mutation mutation;
+  mutation.set_todo_id(id);
+  mutation.set_add_todo(text);
+  Commit(mutation);
+  return id;
+}
+
+uint64_t State::AddTodoFront(const std::string &text) {
+  const uint64_t id = next_todo_id_;
+  Mutation mutation;
+  mutation.set_todo_id(id);
+  mutation.set_add_todo_front(text);
+  Commit(mutation);
+  return id;
+}
+
+void State::ToggleTodo(int index) {
+  if (index < 0 || index >= todos_.size()) {
+    return;
+  }
+  Mutation mutation;
+  mutation.set_toggle_todo_id(todos_[index].id);
+  Commit(mutation);
+}
+
+void State::DeleteTodo(int index) {
+  if (index < 0 || index >= todos_.size()) {
+    return;
+  }
+  Mutation mutation;
+  mutation.set_delete_todo_id(todos_[index].id);
+  Commit(mutation);
+}
+
+void State::RemoveDoneTodos() {
+  Mutation mutation;
+  mutation.set_remove_done_todos(true);
+  Commit(mutation);
+}
+
+void State::SetDay(const std::string &day) {
+  Mutation mutation;
+  mutation.set_set_day(day);
+  Commit(mutation);
+}
+
+void State::ClearHistory() {
+  Mutation mutation;
+  mutation.set_clear_history(true);
+  Commit(mutation);
+}
+
+void State::AddDone(const Done &done) {
+  Mutation mutation;
+  *mutation.mutable_add_done() = done;
+  Commit(mutation);
+}
+
+void State::AddDone(const Done &done, const PomodoroStatus &pomodoro) {
+  Mutation mutation;
+  *mutation.mutable_add_done() = done;
+  *mutation.mutable_pomodoro() = pomodoro;
+  Commit(mutation);
+}
+
+void State::SetPomodoro(const PomodoroStatus &pomodoro) {
+  Mutation mutation;
+  *mutation.mutable_pomodoro() = pomodoro;
+  Commit(mutation);
+}
+
+void State::Submit(Mutation mutation) {
+  mutation.clear_sequence();
+  mutation.clear_todo_id();
+  // The pomodoro is the committer's own.
+  mutation.clear_pomodoro();
+  if (mutation.has_add_todo() || mutation.has_add_todo_front()) {
+    mutation.set_todo_id(next_todo_id_);
+  }
+  Commit(mutation);
+}
+
+void State::Commit(Mutation &mutation) {
+  if (remote_) {
+    remote_->OnMutation(mutation);
+    return;
+  }
+  mutation.set_sequence(sequence_ + 1);
+  Apply(mutation);
+  for (Observer *observer : observers_) {
+    observer->OnMutation(mutation);
+  }
+}
+
+void State::Apply(const Mutation &mutation) {
+  if (mutation.has_sequence()) {
+    sequence_ = mutation.sequence();
+  }
+  if (mutation.has_pomodoro()) {
+    pomodoro_ = mutation.pomodoro();
+  }
+
+  // Journals written before todos had IDs do not carry one.
+  const auto new_todo_id = [&] {
+    const uint64_t id =
+        mutation.has_todo_id() ? mutation.todo_id() : next_todo_id_;
+    next_todo_id_ = std::max(next_todo_id_, id + 1);
+    return id;
+  };
+
+  switch (mutation.change_case()) {
+  case Mutation::kAddTodo:
+    todos_.PushBack(
+        {.id = new_todo_id(), .done = false, .text = mutation.add_todo()});
+    ++todos_version_;
+    break;
+  case Mutation::kAddTodoFront:
+    todos_.PushFront({.id = new_todo_id(),
+                      .done = false,
+                      .text = mutation.add_todo_front()});
+    ++todos_version_;
+    break;
+  case Mutation::kToggleTodo: {
+    const int index = mutation.toggle_todo();
+    if (index >= 0 && index < todos_.size()) {
+      todos_[index].done = !todos_[index].done;
+      ++todos_version_;
+    }
+    break;
+  }
+  case Mutation::kToggleTodoId:
+    if (Todo *todo = todos_.Find(mutation.toggle_todo_id())) {
+      todo->done = !todo->done;
+      ++todos_version_;
+    }
+    break;
+  case Mutation::kDeleteTodo: {
+    const int index = mutation.delete_todo();
+    if (index >= 0 && index < todos_.size()) {
+      todos_.Erase(index);
+      ++todos_version_;
+    }
+    break;
+  }
+  case Mutation::kDeleteTodoId:
+    if (const std::optional<size_t> position =
+            todos_.PositionOf(mutation.delete_todo_id())) {
+      todos_.Erase(*position);
+      ++todos_version_;
+    }
+    break;
+  case Mutation::kRemoveDoneTodos:
+    todos_.RemoveIf([](const Todo &todo) { return todo.done; });
+    ++todos_version_;
+    break;
+  case Mutation::kSetDay:
+    day_ = mutation.set_day();
+    break;
+  case Mutation::kClearHistory:
+    WaitForHistory();
+    history_.clear();
+    phases_.clear();
+    ++history_version_;
+    break;
+  case Mutation::kAddDone:
+    WaitForHistory();
+    history_.push_back(mutation.add_done());
+    UpgradeDoneTimes(day_, &history_.back());
+    phases_.push_back({history_.back().done_type(),
+                       history_.back().duration_seconds()});
+    ++history_version_;
+    break;
+  case Mutation::CHANGE_NOT_SET:
+    break;
+  }
+}
@@ -1,51 +1,125 @@
 #ifndef POMODORO_STATE_H_
 #define POMODORO_STATE_H_
 
+#include <cstdint>
+#include <future>
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include "flat_state.h"
+#include "google/protobuf/io/coded_stream.h"
 #include "state.pb.h"
+#include "todo_list.h"
 
 class State {
 public:
-  struct Todo {
-    bool done;
-    std::string text;
+  using Todo = TodoItem;
+
+  // Gets notified about every change, e.g. to journal it.
+  class Observer {
+  public:
+    virtual ~Observer() = default;
+    virtual void OnMutation(const Mutation &mutation) = 0;
+  };
+
+  // Type and duration of a Done.
+  struct Phase {
+    Done::DoneType type;
+    double duration_seconds;
   };
 
-  State(const StateProto &proto);
+  // `history_bytes` is a serialized TodayHistoryProto with more history, see
+  // LoadStatePartial(). If `proto` has a today summary, it is parsed on a
+  // background thread until history() is needed.
+  // Moves the todos and the history out of `proto`, so pass it as an rvalue
+  // where possible.
+  State(StateProto proto, std::string history_bytes = {});
+  // Reads the todos and phases from `flat`, and the history only once
+  // history() is needed.
+  explicit State(std::shared_ptr<const FlatState> flat);
   StateProto ToProto() const;
+  // Writes what ToProto().SerializeToCodedStream() would, byte for byte, but
+  // straight from the state, without building the StateProto.
+  void SerializeTo(google::protobuf::io::CodedOutputStream *output) const;
+  // Writes the state as a flat state file, see FlatState. Returns false if
+  // its strings do not fit the format's 4 GiB.
+  bool SerializeFlatTo(google::protobuf::io::CodedOutputStream *output) const;
 
   const std::string &day() const { return day_; }
-  const std::vector<Todo> &todos() const { return todos_; }
-  const std::vector<Done> &history() const { return history_; }
-
-  // Manipulate todo list.
-  void AddTodo(const std::string &text) {
-    todos_.push_back({.done = false, .text = text});
-  }
-  void AddTodoFront(const std::string &text) {
-    todos_.insert(todos_.begin(), {.done = false, .text = text});
-  }
-  void ToggleTodo(int index) {
-    if (index >= todos_.size()) {
-      return;
-    }
-    todos_[index].done = !todos_[index].done;
-  }
-  void DeleteTodo(int index) {
-    if (index >= todos_.size()) {
-      return;
-    }
-    todos_.erase(todos_.begin() + index);
+  const TodoList &todos() const { return todos_; }
+  // Waits for the history if it is still being parsed.
+  const std::vector<Done> &history() const {
+    WaitForHistory();
+    return history_;
   }
+  // The phases of history(), available before the history is parsed.
+  const std::vector<Phase> &phases() const { return phases_; }
+  // The pomodoro as of its last change, if it ever changed.
+  const std::optional<PomodoroStatus> &pomodoro() const { return pomodoro_; }
+
+  // Incremented on every change, so views know when to redraw.
+  uint64_t todos_version() const { return todos_version_; }
+  uint64_t history_version() const { return history_version_; }
+
+  // Sequence number of the last change.
+  uint64_t sequence() const { return sequence_; }
+  // Observers are notified in the order they were added.
+  void AddObserver(Observer *observer) { observers_.push_back(observer); }
+  void ClearObservers() { observers_.clear(); }
+  // Hands changes to `remote` instead of applying them, e.g. to send them to
+  // the daemon that owns the state. They come back through Apply().
+  void set_remote(Observer *remote) { remote_ = remote; }
+
+  // Manipulate todo list. Todos are addressed by their current position.
+  // New todos get a fresh ID, which is returned. With a remote, the remote
+  // assigns the ID.
+  uint64_t AddTodo(const std::string &text);
+  uint64_t AddTodoFront(const std::string &text);
+  void ToggleTodo(int index);
+  void DeleteTodo(int index);
+  void RemoveDoneTodos();
 
   // Manipulate history.
-  void SetDay(const std::string &day) { day_ = day; }
-  void ClearHistory() { history_.clear(); }
-  void AddDone(const Done &done) { history_.push_back(done); }
+  void SetDay(const std::string &day);
+  void ClearHistory();
+  void AddDone(const Done &done);
+  // Adds the Done of a block and the pomodoro after booking it at once.
+  void AddDone(const Done &done, const PomodoroStatus &pomodoro);
+
+  // Journals the pomodoro, so that a restarted process can continue it.
+  void SetPomodoro(const PomodoroStatus &pomodoro);
+
+  // Applies a change without notifying observers, e.g. when replaying the
+  // journal.
+  void Apply(const Mutation &mutation);
+  // Commits a change made elsewhere, e.g. by a client of the daemon. New
+  // todos get a fresh ID here.
+  void Submit(Mutation mutation);
 
 private:
+  // Numbers the change, applies it and notifies the observers.
+  void Commit(Mutation &mutation);
+  // Moves the history parsed in the background, or read from the mapped
+  // file, into history_.
+  void WaitForHistory() const;
+
   std::string day_;
-  std::vector<Todo> todos_;
-  std::vector<Done> history_;
+  TodoList todos_;
+  uint64_t next_todo_id_ = 1;
+  // Shared, so that copies of the state can wait for it too.
+  mutable std::shared_future<std::vector<Done>> pending_history_;
+  // The file the history is still to be read from.
+  mutable std::shared_ptr<const FlatState> mapped_history_;
+  mutable std::vector<Done> history_;
+  std::vector<Phase> phases_;
+  std::optional<PomodoroStatus> pomodoro_;
+  uint64_t todos_version_ = 0;
+  uint64_t history_version_ = 0;
+  uint64_t sequence_ = 0;
+  std::vector<Observer *> observers_;
+  Observer *remote_ = nullptr;
 };
 
 #endif // POMODORO_STATE_H_
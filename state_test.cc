@@ -0,0 +1,155 @@
+#include "state.h"
+
+#include <fstream>
+#include <string>
+
+#include "flat_state.h"
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl_lite.h"
+#include "gtest/gtest.h"
+#include "state.pb.h"
+
+namespace {
+
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::StringOutputStream;
+
+std::string Serialize(const State &state) {
+  std::string bytes;
+  {
+    StringOutputStream stream(&bytes);
+    CodedOutputStream output(&stream);
+    state.SerializeTo(&output);
+  }
+  return bytes;
+}
+
+// SerializeTo() must write exactly what the proto would.
+void ExpectSameBytes(const State &state) {
+  const std::string expected = state.ToProto().SerializeAsString();
+  EXPECT_EQ(Serialize(state), expected);
+}
+
+Done MakeDone(int i) {
+  Done done;
+  done.set_done_type(i % 3 == 2 ? Done::BREAK : Done::WORK);
+  done.set_todo("Todo " + std::to_string(i));
+  done.set_duration_seconds(i * 1.5);
+  done.set_start_time_us(1618812000000000 + i * 1000000);
+  done.set_end_time_us(1618812000000000 + i * 2000000);
+  done.set_utc_offset_seconds(7200);
+  done.set_todo_id(i);
+  return done;
+}
+
+StateProto MakeProto() {
+  StateProto proto;
+  proto.set_journal_sequence(123456789);
+  proto.set_next_todo_id(3000);
+  proto.mutable_history()->set_day("2021-04-19");
+  for (int i = 0; i < 100; ++i) {
+    *proto.mutable_history()->add_done() = MakeDone(i);
+  }
+  for (int i = 0; i < 50; ++i) {
+    TodoProto *todo = proto.add_todo_item();
+    todo->set_text(std::string(i, 'x'));
+    todo->set_done(i % 2 == 0);
+    todo->set_id(i * 1000 + 1);
+  }
+  return proto;
+}
+
+TEST(StateSerializeTest, Empty) { ExpectSameBytes(State(StateProto())); }
+
+TEST(StateSerializeTest, EmptyHistory) {
+  StateProto proto;
+  proto.mutable_history()->set_day("2021-04-19");
+  proto.set_next_todo_id(1);
+  ExpectSameBytes(State(proto));
+}
+
+TEST(StateSerializeTest, TodosHistoryAndIds) {
+  ExpectSameBytes(State(MakeProto()));
+}
+
+TEST(StateSerializeTest, LegacyTimesAndTodos) {
+  StateProto proto;
+  proto.add_todo("old todo");
+  proto.add_todo("");
+  proto.mutable_history()->set_day("2021-04-19");
+  Done *done = proto.mutable_history()->add_done();
+  done->set_done_type(Done::WORK);
+  done->set_start_time("09:00");
+  done->set_end_time("09:25");
+  done->set_todo("old todo");
+  done = proto.mutable_history()->add_done();
+  done->set_start_time("");
+  ExpectSameBytes(State(proto));
+}
+
+TEST(StateSerializeTest, Pomodoro) {
+  StateProto proto = MakeProto();
+  PomodoroStatus *pomodoro = proto.mutable_pomodoro();
+  pomodoro->set_work_state(PomodoroStatus::PAUSE);
+  pomodoro->set_pomodoros_done(3);
+  pomodoro->set_target_duration_seconds(300);
+  pomodoro->set_elapsed_seconds(12.5);
+  pomodoro->set_start_time_us(1618812000000000);
+  ExpectSameBytes(State(proto));
+}
+
+TEST(StateSerializeTest, SummaryWithLazyHistory) {
+  StateProto proto = MakeProto();
+  for (const Done &done : proto.history().done()) {
+    proto.mutable_today_summary()->add_done_type(done.done_type());
+    proto.mutable_today_summary()->add_duration_seconds(
+        done.duration_seconds());
+  }
+  // As LoadStatePartial() returns it.
+  const std::string history_bytes = proto.history().SerializeAsString();
+  proto.clear_history();
+  const State state(proto, history_bytes);
+  ExpectSameBytes(state);
+  EXPECT_EQ(state.ToProto().today_summary().done_type_size(), 100);
+  EXPECT_EQ(state.history().size(), 100u);
+}
+
+TEST(StateSerializeTest, AfterChanges) {
+  State state(MakeProto());
+  state.AddTodo("new");
+  state.AddTodoFront("first");
+  state.ToggleTodo(0);
+  state.DeleteTodo(3);
+  state.AddDone(MakeDone(100));
+  PomodoroStatus pomodoro;
+  pomodoro.set_work_state(PomodoroStatus::WORKING);
+  pomodoro.set_start_time_us(1618812000000000);
+  state.SetPomodoro(pomodoro);
+  ExpectSameBytes(state);
+
+  state.RemoveDoneTodos();
+  state.ClearHistory();
+  ExpectSameBytes(state);
+}
+
+TEST(StateSerializeTest, FromFlatState) {
+  StateProto proto = MakeProto();
+  proto.mutable_pomodoro()->set_pomodoros_done(2);
+  const State original(proto);
+  std::string bytes;
+  {
+    StringOutputStream stream(&bytes);
+    CodedOutputStream output(&stream);
+    ASSERT_TRUE(original.SerializeFlatTo(&output));
+  }
+  const std::string path = testing::TempDir() + "/state_test.flat";
+  std::ofstream(path, std::ios::binary) << bytes;
+
+  const std::shared_ptr<const FlatState> flat = FlatState::Open(path);
+  ASSERT_NE(flat, nullptr);
+  const State state(flat);
+  ExpectSameBytes(state);
+  EXPECT_EQ(Serialize(state), Serialize(original));
+}
+
+} // namespace
@@ -0,0 +1,65 @@
+// cprd_status: prints the status of the running cprd in one line, e.g. for a
+// tmux status line or a shell prompt. Prints nothing if cprd is not running.
+//
+// Usage: cprd_status [path of the status page]
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+
+#include "status_page.h"
+
+namespace {
+
+constexpr char kStatusPagePath[] = "/Users/hosang/cprd.status";
+
+// "m:ss" of `seconds`.
+std::string FormatMinutes(int64_t seconds) {
+  char buffer[32];
+  std::snprintf(buffer, sizeof buffer, "%lld:%02lld",
+                static_cast<long long>(seconds / 60),
+                static_cast<long long>(seconds % 60));
+  return buffer;
+}
+
+} // namespace
+
+int main(int argc, char **argv) {
+  const StatusPageReader reader(argc > 1 ? argv[1] : kStatusPagePath);
+  StatusPageData data;
+  if (!reader.Read(&data)) {
+    return 1;
+  }
+
+  const int64_t now_us =
+      std::chrono::duration_cast<std::chrono::microseconds>(
+          std::chrono::system_clock::now().time_since_epoch())
+          .count();
+  // Timer seconds until the timer rings, negative once it rang.
+  const int64_t remaining =
+      data.deadline_us == 0
+          ? 0
+          : static_cast<int64_t>((data.deadline_us - now_us) / 1e6 *
+                                 data.time_scale);
+
+  std::string text;
+  switch (data.work_state) {
+  case 0:
+    text = "work " + FormatMinutes(std::max<int64_t>(remaining, 0));
+    break;
+  case 1:
+    text = "work DONE (+" + FormatMinutes(std::max<int64_t>(-remaining, 0)) +
+           ")";
+    break;
+  case 2:
+    text = "pause " + FormatMinutes(std::max<int64_t>(remaining, 0));
+    break;
+  default:
+    text = "pause OVER";
+    break;
+  }
+  std::printf("%s %d %s\n", text.c_str(), data.pomodoros_done, data.todo);
+  return 0;
+}
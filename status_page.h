@@ -0,0 +1,126 @@
+#ifndef POMODORO_STATUS_PAGE_H_
+#define POMODORO_STATUS_PAGE_H_
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <signal.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <thread>
+#include <unistd.h>
+
+// The pomodoro status as the running cprd publishes it in a small shared
+// file, for status lines and prompts. Once the file is mapped, reading it
+// takes no syscalls.
+//
+// The file is one StatusPage. It is a seqlock: the writer makes the sequence
+// odd, updates the data and makes the sequence even again. Readers copy the
+// data and retry if the sequence was odd or changed meanwhile. A writer that
+// died while writing leaves the sequence odd, so readers give up eventually.
+//
+// This header only needs the C++ standard library, so that readers stay
+// small.
+
+struct StatusPageData {
+  static constexpr uint32_t kMagic = 0x31647063; // "cpd1"
+
+  uint32_t magic;
+  // Of the writer, 0 once it exited.
+  int32_t pid;
+  // PomodoroStatus::WorkState: 0 working, 1 work done, 2 pause, 3 pause over.
+  int32_t work_state;
+  int32_t pomodoros_done;
+  // When the timer rings or rang, in microseconds since the epoch. 0 if no
+  // timer runs.
+  int64_t deadline_us;
+  // Timer seconds per real second.
+  double time_scale;
+  // The selected todo, NUL-terminated and possibly cut.
+  char todo[208];
+};
+
+struct StatusPage {
+  std::atomic<uint32_t> sequence;
+  uint32_t padding;
+  StatusPageData data;
+};
+static_assert(std::atomic<uint32_t>::is_always_lock_free);
+
+// Copies a consistent snapshot of `page` into `data`. Returns false if there
+// was none after many attempts.
+inline bool ReadStatusPage(const StatusPage &page, StatusPageData *data) {
+  constexpr int kMaxAttempts = 1000;
+  for (int attempt = 0; attempt < kMaxAttempts; ++attempt) {
+    const uint32_t before = page.sequence.load(std::memory_order_acquire);
+    if (before % 2 == 0) {
+      std::memcpy(data, &page.data, sizeof *data);
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (page.sequence.load(std::memory_order_relaxed) == before) {
+        return true;
+      }
+    }
+    // Lets a writer that was preempted while writing finish.
+    std::this_thread::yield();
+  }
+  return false;
+}
+
+// Maps the status page at `path` for reading.
+class StatusPageReader {
+public:
+  explicit StatusPageReader(const std::string &path) {
+    const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    // Reading past the end of the file would crash.
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(StatusPage))) {
+      void *page =
+          mmap(nullptr, sizeof(StatusPage), PROT_READ, MAP_SHARED, fd, 0);
+      if (page != MAP_FAILED) {
+        page_ = static_cast<const StatusPage *>(page);
+      }
+    }
+    close(fd);
+  }
+  ~StatusPageReader() {
+    if (page_) {
+      munmap(const_cast<StatusPage *>(page_), sizeof(StatusPage));
+    }
+  }
+  StatusPageReader(const StatusPageReader &) = delete;
+  StatusPageReader &operator=(const StatusPageReader &) = delete;
+
+  // False if there is no status page, e.g. because cprd never ran.
+  bool ok() const { return page_ != nullptr; }
+
+  // False if cprd is not running or the page is not valid.
+  //
+  // cprd clears the pid when it exits, but it stays set if cprd was killed.
+  // So whether a writer runs is checked the first time its pid shows up,
+  // which a reader that outlives a killed cprd does not notice.
+  bool Read(StatusPageData *data) const {
+    if (!page_ || !ReadStatusPage(*page_, data) ||
+        data->magic != StatusPageData::kMagic || data->pid == 0) {
+      return false;
+    }
+    if (data->pid != checked_pid_) {
+      checked_pid_ = data->pid;
+      // EPERM means it runs as someone else.
+      writer_runs_ = kill(data->pid, 0) == 0 || errno == EPERM;
+    }
+    return writer_runs_;
+  }
+
+private:
+  const StatusPage *page_ = nullptr;
+  mutable int32_t checked_pid_ = 0;
+  mutable bool writer_runs_ = false;
+};
+
+#endif // POMODORO_STATUS_PAGE_H_
@@ -0,0 +1,68 @@
+#include "status_writer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+#include "time_utils.h"
+
+StatusPageWriter::StatusPageWriter(const std::string &path) : path_(path) {
+  const int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0 || ftruncate(fd, sizeof(StatusPage)) != 0) {
+    std::cout << "Could not write to '" << path << "'.\n";
+    if (fd >= 0) {
+      close(fd);
+    }
+    return;
+  }
+  void *page = mmap(nullptr, sizeof(StatusPage), PROT_READ | PROT_WRITE,
+                    MAP_SHARED, fd, 0);
+  close(fd);
+  if (page != MAP_FAILED) {
+    page_ = static_cast<StatusPage *>(page);
+  }
+}
+
+StatusPageWriter::~StatusPageWriter() {
+  if (!page_) {
+    return;
+  }
+  StatusPageData data = page_->data;
+  data.pid = 0;
+  Write(data);
+  munmap(page_, sizeof(StatusPage));
+}
+
+void StatusPageWriter::Publish(const PomodoroStatus &status,
+                               const std::string &todo) {
+  if (!page_) {
+    return;
+  }
+  // Zeroed, so that equal data compares equal byte by byte.
+  StatusPageData data = {};
+  data.magic = StatusPageData::kMagic;
+  data.pid = getpid();
+  data.work_state = status.work_state();
+  data.pomodoros_done = status.pomodoros_done();
+  if (status.has_start_time_us()) {
+    data.deadline_us =
+        status.start_time_us() +
+        std::llround(status.target_duration_seconds() * 1e6 /
+                     RealClock::kTimeAcceleration);
+  }
+  data.time_scale = RealClock::kTimeAcceleration;
+  todo.copy(data.todo, std::min(todo.size(), sizeof data.todo - 1));
+
+  // Only this process writes, so the page can be compared without the lock.
+  if (std::memcmp(&data, &page_->data, sizeof data) != 0) {
+    Write(data);
+  }
+}
+
+void StatusPageWriter::Write(const StatusPageData &data) {
+  const uint32_t sequence = page_->sequence.load(std::memory_order_relaxed);
+  page_->sequence.store(sequence + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  std::memcpy(&page_->data, &data, sizeof data);
+  page_->sequence.store(sequence + 2, std::memory_order_release);
+}
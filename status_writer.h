@@ -0,0 +1,30 @@
+#ifndef POMODORO_STATUS_WRITER_H_
+#define POMODORO_STATUS_WRITER_H_
+
+#include <string>
+
+#include "state.pb.h"
+#include "status_page.h"
+
+// Publishes the pomodoro status on the status page at `path`, see
+// status_page.h. Only the process that owns the timer should publish.
+class StatusPageWriter {
+public:
+  explicit StatusPageWriter(const std::string &path);
+  // Tells readers that cprd is no longer running.
+  ~StatusPageWriter();
+  StatusPageWriter(const StatusPageWriter &) = delete;
+  StatusPageWriter &operator=(const StatusPageWriter &) = delete;
+
+  // Publishes `status` and the selected `todo`. Cheap if nothing changed, so
+  // it can be called on every wakeup.
+  void Publish(const PomodoroStatus &status, const std::string &todo);
+
+private:
+  void Write(const StatusPageData &data);
+
+  std::string path_;
+  StatusPage *page_ = nullptr;
+};
+
+#endif // POMODORO_STATUS_WRITER_H_
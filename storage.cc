@@ -0,0 +1,222 @@
+#include "storage.h"
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+
+#include "google/protobuf/io/coded_stream.h"
+#include "google/protobuf/io/zero_copy_stream_impl.h"
+#include "google/protobuf/wire_format_lite.h"
+
+#include "time_utils.h"
+#include "trace.h"
+
+namespace {
+
+using google::protobuf::io::CodedInputStream;
+using google::protobuf::io::CodedOutputStream;
+using google::protobuf::io::FileInputStream;
+using google::protobuf::io::FileOutputStream;
+using google::protobuf::internal::WireFormatLite;
+
+// The state is written in pieces of this size, whatever its total size.
+constexpr int kSaveBufferBytes = 64 << 10;
+
+// Writes `path` through `write`, which returns false on failure, by way of a
+// temporary file, so a crash leaves either the old or the new file behind.
+bool WriteAtomically(const std::string &path,
+                     const std::function<bool(CodedOutputStream *)> &write) {
+  const std::string tmp_path = path + ".tmp";
+  const int fd =
+      open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    std::cout << "Could not write to '" << tmp_path << "'.\n";
+    return false;
+  }
+  bool ok;
+  {
+    FileOutputStream file(fd, kSaveBufferBytes);
+    {
+      CodedOutputStream output(&file);
+      ok = write(&output) && !output.HadError();
+    }
+    ok = file.Close() && ok;
+  }
+  if (!ok) {
+    std::cout << "Could not write to '" << tmp_path << "'.\n";
+    unlink(tmp_path.c_str());
+    return false;
+  }
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+} // namespace
+
+std::string GetDay() {
+  char buf[sizeof "2021-04-19"];
+  time_t now;
+  time(&now);
+  strftime(buf, sizeof buf, "%F", localtime(&now));
+  return std::string(buf);
+}
+
+void SaveTodo(const std::string &path, const std::string &day,
+              const TodoList &items) {
+  TRACE_SPAN("SaveTodo");
+  std::ofstream os(path, std::ios_base::app);
+  if (!os.is_open()) {
+    std::cout << "Could not write to '" << path << "'.\n";
+    return;
+  }
+
+  os << "\n";
+  os << day << "\n";
+  for (const State::Todo &item : items) {
+    char done_indicator = item.done ? 'x' : ' ';
+    os << " " << done_indicator << " " << item.text << "\n";
+  }
+}
+
+void SaveTodayTxt(const std::string &path, const State &state) {
+  TRACE_SPAN("SaveTodayTxt");
+  std::ofstream os(path, std::ios_base::app);
+  if (!os.is_open()) {
+    std::cout << "Could not write to '" << path << "'.\n";
+    return;
+  }
+
+  os << "\n" << state.day() << "\n";
+  for (const Done &done : state.history()) {
+    if (done.done_type() != Done::WORK)
+      continue;
+    const int duration_minutes = std::lround(done.duration_seconds() / 60);
+    const int32_t utc_offset = done.utc_offset_seconds();
+    os << "  " << FormatClock(done.start_time_us(), utc_offset) << " "
+       << FormatClock(done.end_time_us(), utc_offset) << " "
+       << duration_minutes << "m " << done.todo() << "\n";
+  }
+}
+
+StateProto LoadState(const std::string &path) {
+  TRACE_SPAN("LoadState");
+  StateProto state;
+  std::ifstream is(path, std::ios::binary);
+  state.ParseFromIstream(&is);
+  return state;
+}
+
+PartialState LoadStatePartial(const std::string &path) {
+  TRACE_SPAN("LoadStatePartial");
+  PartialState partial;
+  std::ifstream is(path, std::ios::binary);
+  const std::string data((std::istreambuf_iterator<char>(is)),
+                         std::istreambuf_iterator<char>());
+
+  // Copy all fields but the history into `rest`, and the history into
+  // history_bytes. Concatenated messages merge, like repeated fields do.
+  std::string rest;
+  CodedInputStream input(reinterpret_cast<const uint8_t *>(data.data()),
+                         data.size());
+  while (true) {
+    const int begin = input.CurrentPosition();
+    const uint32_t tag = input.ReadTag();
+    if (tag == 0) {
+      break;
+    }
+    if (WireFormatLite::GetTagFieldNumber(tag) ==
+            StateProto::kHistoryFieldNumber &&
+        WireFormatLite::GetTagWireType(tag) ==
+            WireFormatLite::WIRETYPE_LENGTH_DELIMITED) {
+      uint32_t length;
+      std::string history;
+      if (!input.ReadVarint32(&length) || !input.ReadString(&history, length)) {
+        break;
+      }
+      partial.history_bytes += history;
+    } else {
+      if (!WireFormatLite::SkipField(&input, tag)) {
+        break;
+      }
+      rest.append(data, begin, input.CurrentPosition() - begin);
+    }
+  }
+  partial.proto.ParseFromString(rest);
+
+  // The day is the first field of the history, as fields are written in
+  // order of their numbers. Otherwise, parse it all right away.
+  CodedInputStream history(
+      reinterpret_cast<const uint8_t *>(partial.history_bytes.data()),
+      partial.history_bytes.size());
+  std::string day;
+  uint32_t length;
+  if (history.ReadTag() ==
+          WireFormatLite::MakeTag(TodayHistoryProto::kDayFieldNumber,
+                                  WireFormatLite::WIRETYPE_LENGTH_DELIMITED) &&
+      history.ReadVarint32(&length) && history.ReadString(&day, length)) {
+    partial.proto.mutable_history()->set_day(day);
+  } else {
+    partial.proto.mutable_history()->ParseFromString(partial.history_bytes);
+    partial.history_bytes.clear();
+  }
+  return partial;
+}
+
+uint64_t LoadJournalSequence(const std::string &path) {
+  TRACE_SPAN("LoadJournalSequence");
+  const int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return 0;
+  }
+  uint64_t sequence = 0;
+  {
+    // Skipping the history seeks past it.
+    FileInputStream stream(fd);
+    CodedInputStream input(&stream);
+    const uint32_t sequence_tag =
+        WireFormatLite::MakeTag(StateProto::kJournalSequenceFieldNumber,
+                                WireFormatLite::WIRETYPE_VARINT);
+    while (const uint32_t tag = input.ReadTag()) {
+      if (tag == sequence_tag ? !input.ReadVarint64(&sequence)
+                              : !WireFormatLite::SkipField(&input, tag)) {
+        break;
+      }
+    }
+  }
+  close(fd);
+  return sequence;
+}
+
+bool SaveState(const std::string &path, const StateProto &state_proto) {
+  TRACE_SPAN("SaveState");
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream os(tmp_path, std::ios::binary);
+    if (!state_proto.SerializeToOstream(&os) || !os.flush()) {
+      std::cout << "Could not write to '" << tmp_path << "'.\n";
+      return false;
+    }
+  }
+  return std::rename(tmp_path.c_str(), path.c_str()) == 0;
+}
+
+bool SaveState(const std::string &path, const State &state) {
+  TRACE_SPAN("SaveState");
+  return WriteAtomically(path, [&](CodedOutputStream *output) {
+    state.SerializeTo(output);
+    return true;
+  });
+}
+
+bool SaveFlatState(const std::string &path, const State &state) {
+  TRACE_SPAN("SaveFlatState");
+  return WriteAtomically(path, [&](CodedOutputStream *output) {
+    return state.SerializeFlatTo(output);
+  });
+}
@@ -0,0 +1,45 @@
+#ifndef POMODORO_STORAGE_H_
+#define POMODORO_STORAGE_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "state.h"
+#include "state.pb.h"
+
+// Today as "YYYY-MM-DD" in local time.
+std::string GetDay();
+
+// Appends the todo list as a human-readable block to `path`.
+void SaveTodo(const std::string &path, const std::string &day,
+              const TodoList &items);
+// Appends today's work as a human-readable block to `path`.
+void SaveTodayTxt(const std::string &path, const State &state);
+
+StateProto LoadState(const std::string &path);
+
+// A state file with the history left serialized, for State to parse later.
+struct PartialState {
+  // Everything but the history's Done messages.
+  StateProto proto;
+  // Serialized TodayHistoryProto.
+  std::string history_bytes;
+};
+// Like LoadState(), but only skips over the history instead of parsing it.
+PartialState LoadStatePartial(const std::string &path);
+// The journal_sequence of the state at `path`, without reading the rest of
+// it. 0 if there is none.
+uint64_t LoadJournalSequence(const std::string &path);
+
+// Replaces the file at `path` atomically, so a crash leaves either the old or
+// the new state behind. Returns false if the state could not be written.
+bool SaveState(const std::string &path, const StateProto &state_proto);
+// Like SaveState(path, state.ToProto()), but streams the state to the file
+// through a fixed-size buffer instead of building the proto first.
+bool SaveState(const std::string &path, const State &state);
+// Saves `state` as a flat state file for State(FlatState::Open(path)), in the
+// same way.
+bool SaveFlatState(const std::string &path, const State &state);
+
+#endif // POMODORO_STORAGE_H_
@@ -0,0 +1,144 @@
+#include "team_load.h"
+
+#include <algorithm>
+#include <memory>
+#include <poll.h>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "channel.h"
+#include "state.pb.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How long to wait for outstanding replies after the run.
+constexpr auto kDrainTimeout = std::chrono::seconds(5);
+
+double Percentile(std::vector<Clock::duration> &latencies, double fraction) {
+  if (latencies.empty()) {
+    return 0;
+  }
+  const auto nth = latencies.begin() + static_cast<size_t>(
+                                           fraction * (latencies.size() - 1));
+  std::nth_element(latencies.begin(), nth, latencies.end());
+  return std::chrono::duration<double, std::micro>(*nth).count();
+}
+
+// The next command of a user: mostly starting and stopping, sometimes
+// toggling the first todo.
+TeamRequest MakeRequest(int user, std::mt19937 &random) {
+  TeamRequest request;
+  request.set_user("user" + std::to_string(user));
+  request.set_request_id(user);
+  ClientMessage *message = request.mutable_message();
+  switch (random() % 5) {
+  case 0:
+  case 1:
+    message->set_command(ClientMessage::START);
+    break;
+  case 2:
+  case 3:
+    message->set_command(ClientMessage::STOP);
+    break;
+  case 4:
+    message->mutable_mutation()->set_toggle_todo_id(1);
+    break;
+  }
+  return request;
+}
+
+} // namespace
+
+std::optional<TeamLoadResult> RunTeamLoad(const TeamLoadOptions &options) {
+  std::vector<std::unique_ptr<Channel>> channels;
+  for (int i = 0; i < std::max(options.connections, 1); ++i) {
+    const int fd = ConnectUnix(options.socket_path);
+    if (fd < 0) {
+      return std::nullopt;
+    }
+    channels.push_back(std::make_unique<Channel>(fd));
+  }
+
+  std::mt19937 random(42);
+  std::vector<Clock::time_point> sent(options.users);
+  std::vector<Clock::duration> latencies;
+  TeamLoadResult result;
+  int64_t in_flight = 0;
+  const auto send = [&](int user) {
+    sent[user] = Clock::now();
+    channels[user % channels.size()]->Queue(
+        MakeRequest(user, random).SerializeAsString());
+    ++in_flight;
+  };
+
+  const Clock::time_point start = Clock::now();
+  const Clock::time_point end = start + options.duration;
+  for (int user = 0; user < options.users; ++user) {
+    send(user);
+  }
+
+  std::vector<pollfd> fds(channels.size());
+  while (in_flight > 0) {
+    const Clock::time_point now = Clock::now();
+    if (now > end + kDrainTimeout) {
+      break;
+    }
+    for (size_t i = 0; i < channels.size(); ++i) {
+      if (!channels[i]->Flush()) {
+        return std::nullopt;
+      }
+      fds[i] = {.fd = channels[i]->fd(),
+                .events = static_cast<short>(
+                    POLLIN | (channels[i]->has_output() ? POLLOUT : 0)),
+                .revents = 0};
+    }
+    if (poll(fds.data(), fds.size(), /*timeout=*/100) < 0) {
+      continue;
+    }
+    for (size_t i = 0; i < channels.size(); ++i) {
+      if (!(fds[i].revents & POLLIN)) {
+        continue;
+      }
+      if (!channels[i]->Receive()) {
+        return std::nullopt;
+      }
+      TeamReply reply;
+      while (channels[i]->Next(&reply)) {
+        // Replies without a request ID tell that a pomodoro rang.
+        if (!reply.has_request_id()) {
+          continue;
+        }
+        const Clock::time_point received = Clock::now();
+        const int user = reply.request_id();
+        latencies.push_back(received - sent[user]);
+        --in_flight;
+        ++result.commands;
+        if (reply.has_error()) {
+          ++result.errors;
+        }
+        if (received < end) {
+          send(user);
+        }
+      }
+      if (channels[i]->corrupt()) {
+        return std::nullopt;
+      }
+    }
+  }
+
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  result.p50_us = Percentile(latencies, 0.5);
+  result.p99_us = Percentile(latencies, 0.99);
+  result.max_us = Percentile(latencies, 1);
+  return result;
+}
+
+void PrintTeamLoad(std::ostream &os, const TeamLoadResult &result) {
+  os << result.commands << " commands in " << result.seconds << " s ("
+     << result.CommandsPerSecond() << " per second, " << result.errors
+     << " errors). Latency p50 " << result.p50_us << " us, p99 "
+     << result.p99_us << " us, max " << result.max_us << " us.\n";
+}
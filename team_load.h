@@ -0,0 +1,41 @@
+#ifndef POMODORO_TEAM_LOAD_H_
+#define POMODORO_TEAM_LOAD_H_
+
+#include <chrono>
+#include <cstdint>
+#include <optional>
+#include <ostream>
+#include <string>
+
+// Simulates many users of a TeamServer starting and stopping their pomodoros
+// and toggling todos, to measure command latency and throughput. Every user
+// waits for the reply to a command before sending the next one.
+struct TeamLoadOptions {
+  std::string socket_path;
+  int users = 10000;
+  // The users are spread over this many connections.
+  int connections = 16;
+  std::chrono::milliseconds duration = std::chrono::seconds(5);
+};
+
+struct TeamLoadResult {
+  int64_t commands = 0;
+  int64_t errors = 0;
+  double seconds = 0;
+  // From sending a command until its reply arrived.
+  double p50_us = 0;
+  double p99_us = 0;
+  double max_us = 0;
+
+  double CommandsPerSecond() const {
+    return seconds > 0 ? commands / seconds : 0;
+  }
+};
+
+// Returns std::nullopt if the server at `options.socket_path` could not be
+// reached.
+std::optional<TeamLoadResult> RunTeamLoad(const TeamLoadOptions &options);
+
+void PrintTeamLoad(std::ostream &os, const TeamLoadResult &result);
+
+#endif // POMODORO_TEAM_LOAD_H_
@@ -0,0 +1,430 @@
+#include "team_server.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <functional>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <utility>
+
+#include "state.h"
+#include "storage.h"
+#include "timer_wheel.h"
+#include "trace.h"
+#include "ui.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+// How often changed users are handed to the writer.
+constexpr auto kSaveInterval = std::chrono::seconds(1);
+
+// One user, owned by the worker thread of its shard.
+struct Session : public State::Observer {
+  // Calls `on_ring` with the session when its pomodoro rings from `timers`.
+  // Both must outlive the session.
+  Session(std::string user, StateProto proto, TimerWheel &timers,
+          const std::function<void(Session &)> &on_ring)
+      : user(std::move(user)), state(std::move(proto)), todo(state),
+        pomodoro(state, todo, timers, [this, &on_ring] { on_ring(*this); }) {
+    state.AddObserver(this);
+  }
+
+  void OnMutation(const Mutation &mutation) override {
+    mutations.push_back(mutation);
+  }
+
+  const std::string user;
+  State state;
+  Todo todo;
+  Pomodoro pomodoro;
+  // Committed since the last reply.
+  std::vector<Mutation> mutations;
+  // Where the user's last request came from, to tell it when the pomodoro
+  // rings.
+  uint64_t connection = 0;
+  bool dirty = false;
+};
+
+void SignalEventFd(int fd) {
+  const uint64_t one = 1;
+  static_cast<void>(write(fd, &one, sizeof one));
+}
+
+} // namespace
+
+struct TeamServer::Shard {
+  explicit Shard(TeamServer &server) : server(server) {}
+
+  // Takes a batch of requests from the I/O thread.
+  void Push(std::vector<Job> &batch) {
+    {
+      std::lock_guard lock(mutex);
+      jobs.insert(jobs.end(), std::make_move_iterator(batch.begin()),
+                  std::make_move_iterator(batch.end()));
+    }
+    wake.notify_one();
+    batch.clear();
+  }
+
+  void Stop() {
+    {
+      std::lock_guard lock(mutex);
+      stopping = true;
+    }
+    wake.notify_one();
+    worker.join();
+    writer.join();
+  }
+
+  void Work() {
+    std::vector<Job> batch;
+    Clock::time_point next_save = Clock::now() + kSaveInterval;
+    while (true) {
+      {
+        std::unique_lock lock(mutex);
+        const Clock::time_point deadline =
+            std::min(wakeups.NextDeadline().value_or(next_save), next_save);
+        wake.wait_until(lock, deadline,
+                        [&] { return !jobs.empty() || stopping; });
+        if (jobs.empty() && stopping) {
+          break;
+        }
+        batch.swap(jobs);
+      }
+      {
+        TRACE_SPAN("TeamServer::Shard::Work");
+        for (const Job &job : batch) {
+          Handle(job);
+        }
+        batch.clear();
+        wakeups.Advance(Clock::now());
+        server.QueueReplies(replies);
+      }
+      if (Clock::now() >= next_save) {
+        QueueSaves();
+        next_save = Clock::now() + kSaveInterval;
+      }
+    }
+    QueueSaves();
+    {
+      std::lock_guard lock(save_mutex);
+      writer_stopping = true;
+    }
+    save_wake.notify_one();
+  }
+
+  void Handle(const Job &job) {
+    const TeamRequest &request = job.request;
+    TeamReply reply;
+    reply.set_user(request.user());
+    reply.set_request_id(request.request_id());
+    if (!IsValidUser(request.user())) {
+      reply.set_error("Invalid user name.");
+      replies.push_back({job.connection, reply.SerializeAsString()});
+      return;
+    }
+
+    Session &session = Find(request.user());
+    session.connection = job.connection;
+    const ClientMessage &message = request.message();
+    if (message.has_current_todo_id()) {
+      session.todo.Select(message.current_todo_id());
+    }
+    switch (message.request_case()) {
+    case ClientMessage::kMutation:
+      session.state.Submit(message.mutation());
+      session.todo.ClampSelection();
+      break;
+    case ClientMessage::kCommand:
+      switch (message.command()) {
+      case ClientMessage::START:
+        session.pomodoro.Start();
+        break;
+      case ClientMessage::STOP:
+        session.pomodoro.Stop();
+        break;
+      case ClientMessage::RESET:
+        session.pomodoro.Reset();
+        break;
+      case ClientMessage::COMMAND_UNSPECIFIED:
+        break;
+      }
+      break;
+    case ClientMessage::REQUEST_NOT_SET:
+      break;
+    }
+
+    if (!session.mutations.empty()) {
+      for (Mutation &mutation : session.mutations) {
+        *reply.add_mutation() = std::move(mutation);
+      }
+      session.mutations.clear();
+      if (!session.dirty) {
+        session.dirty = true;
+        dirty.push_back(&session);
+      }
+    }
+    *reply.mutable_status() = session.pomodoro.Status();
+    replies.push_back({job.connection, reply.SerializeAsString()});
+  }
+
+  Session &Find(const std::string &user) {
+    std::unique_ptr<Session> &session = sessions[user];
+    if (!session) {
+      StateProto proto = LoadState(Path(user));
+      if (!proto.history().has_day()) {
+        proto.mutable_history()->set_day(GetDay());
+      }
+      session = std::make_unique<Session>(
+          user, std::move(proto), wakeups, ring);
+      users.store(sessions.size(), std::memory_order_relaxed);
+    }
+    return *session;
+  }
+
+  std::string Path(const std::string &user) const {
+    return server.directory_ + "/" + user + ".StateProto.bp";
+  }
+
+  // Tells the user's connection that the pomodoro rang.
+  void Ring(Session &session) {
+    TeamReply reply;
+    *reply.mutable_status() = session.pomodoro.Status();
+    replies.push_back({session.connection, reply.SerializeAsString()});
+  }
+
+  // Hands snapshots of the changed users to the writer.
+  void QueueSaves() {
+    if (dirty.empty()) {
+      return;
+    }
+    std::vector<std::pair<std::string, StateProto>> saves;
+    for (Session *session : dirty) {
+      saves.emplace_back(Path(session->user), session->state.ToProto());
+      session->dirty = false;
+    }
+    dirty.clear();
+    {
+      std::lock_guard lock(save_mutex);
+      for (auto &[path, proto] : saves) {
+        // Replaces an older snapshot that was not written yet.
+        pending_saves[path] = std::move(proto);
+      }
+    }
+    save_wake.notify_one();
+  }
+
+  void Write() {
+    std::unordered_map<std::string, StateProto> saves;
+    while (true) {
+      {
+        std::unique_lock lock(save_mutex);
+        save_wake.wait(lock,
+                       [&] { return !pending_saves.empty() || writer_stopping; });
+        if (pending_saves.empty()) {
+          return;
+        }
+        saves.swap(pending_saves);
+      }
+      for (const auto &[path, proto] : saves) {
+        SaveState(path, proto);
+      }
+      saved.fetch_add(saves.size(), std::memory_order_relaxed);
+      saves.clear();
+    }
+  }
+
+  TeamServer &server;
+
+  // The worker's queue.
+  std::mutex mutex;
+  std::condition_variable wake;
+  std::vector<Job> jobs;
+  bool stopping = false;
+
+  // Owned by the worker. The pomodoros of all sessions ring from wakeups,
+  // which therefore outlives them.
+  TimerWheel wakeups{Clock::now()};
+  const std::function<void(Session &)> ring = [this](Session &session) {
+    Ring(session);
+  };
+  std::unordered_map<std::string, std::unique_ptr<Session>> sessions;
+  std::vector<Session *> dirty;
+  std::vector<Reply> replies;
+
+  // The writer's queue, by path.
+  std::mutex save_mutex;
+  std::condition_variable save_wake;
+  std::unordered_map<std::string, StateProto> pending_saves;
+  bool writer_stopping = false;
+
+  std::atomic<int64_t> users = 0;
+  std::atomic<int64_t> saved = 0;
+  std::thread worker;
+  std::thread writer;
+};
+
+TeamServer::TeamServer(int listen_fd, std::string directory, int shards)
+    : listen_fd_(listen_fd), directory_(std::move(directory)),
+      reply_fd_(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) {
+  std::filesystem::create_directories(directory_);
+  loop_.Watch(listen_fd_);
+  loop_.Watch(reply_fd_);
+  for (int i = 0; i < std::max(shards, 1); ++i) {
+    shards_.push_back(std::make_unique<Shard>(*this));
+  }
+  for (const std::unique_ptr<Shard> &shard : shards_) {
+    shard->worker = std::thread(&Shard::Work, shard.get());
+    shard->writer = std::thread(&Shard::Write, shard.get());
+  }
+}
+
+TeamServer::~TeamServer() {
+  for (const std::unique_ptr<Shard> &shard : shards_) {
+    shard->Stop();
+  }
+  for (const auto &[connection, channel] : connections_) {
+    loop_.Unwatch(channel->fd());
+  }
+  loop_.Unwatch(reply_fd_);
+  loop_.Unwatch(listen_fd_);
+  close(reply_fd_);
+  close(listen_fd_);
+}
+
+void TeamServer::Run(int stop_fd) {
+  loop_.Watch(stop_fd);
+  std::vector<std::vector<Job>> batches(shards_.size());
+  while (true) {
+    const std::vector<int> ready = loop_.Wait(std::nullopt);
+    if (std::find(ready.begin(), ready.end(), stop_fd) != ready.end()) {
+      break;
+    }
+    for (const int fd : ready) {
+      if (fd == listen_fd_) {
+        Accept();
+      } else if (fd == reply_fd_) {
+        SendReplies();
+      } else if (const auto it = connection_fds_.find(fd);
+                 it != connection_fds_.end()) {
+        Read(it->second, batches);
+      }
+    }
+    for (size_t i = 0; i < shards_.size(); ++i) {
+      if (!batches[i].empty()) {
+        shards_[i]->Push(batches[i]);
+      }
+    }
+  }
+  loop_.Unwatch(stop_fd);
+}
+
+TeamServer::Stats TeamServer::stats() const {
+  Stats stats;
+  stats.requests = requests_.load(std::memory_order_relaxed);
+  for (const std::unique_ptr<Shard> &shard : shards_) {
+    stats.users += shard->users.load(std::memory_order_relaxed);
+    stats.saves += shard->saved.load(std::memory_order_relaxed);
+  }
+  return stats;
+}
+
+bool TeamServer::IsValidUser(const std::string &user) {
+  constexpr size_t kMaxLength = 64;
+  if (user.empty() || user.size() > kMaxLength || user[0] == '.') {
+    return false;
+  }
+  return std::all_of(user.begin(), user.end(), [](char c) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+           (c >= '0' && c <= '9') || c == '_' || c == '-' || c == '.';
+  });
+}
+
+void TeamServer::Accept() {
+  while (true) {
+    const int fd = accept4(listen_fd_, nullptr, nullptr,
+                           SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      return;
+    }
+    const uint64_t connection = next_connection_++;
+    connections_[connection] = std::make_unique<Channel>(fd);
+    connection_fds_[fd] = connection;
+    loop_.Watch(fd);
+  }
+}
+
+void TeamServer::Read(uint64_t connection,
+                      std::vector<std::vector<Job>> &batches) {
+  Channel &channel = *connections_.at(connection);
+  const bool ok = channel.Receive();
+  TeamRequest request;
+  while (channel.Next(&request)) {
+    const size_t shard =
+        std::hash<std::string>()(request.user()) % shards_.size();
+    batches[shard].push_back({connection, std::move(request)});
+    requests_.fetch_add(1, std::memory_order_relaxed);
+  }
+  Update(connection, channel, ok && !channel.corrupt());
+}
+
+void TeamServer::SendReplies() {
+  uint64_t signaled;
+  static_cast<void>(read(reply_fd_, &signaled, sizeof signaled));
+  std::vector<Reply> replies;
+  {
+    std::lock_guard lock(replies_mutex_);
+    replies.swap(replies_);
+  }
+  // Queued first and written once per connection.
+  std::vector<std::pair<uint64_t, bool>> written;
+  for (const Reply &reply : replies) {
+    const auto it = connections_.find(reply.connection);
+    if (it == connections_.end()) {
+      continue;
+    }
+    if (written.empty() || written.back().first != reply.connection) {
+      written.emplace_back(reply.connection, true);
+    }
+    written.back().second &= it->second->Queue(reply.payload);
+  }
+  for (const auto &[connection, ok] : written) {
+    if (const auto it = connections_.find(connection);
+        it != connections_.end()) {
+      Update(connection, *it->second, ok);
+    }
+  }
+}
+
+void TeamServer::Update(uint64_t connection, Channel &channel, bool ok) {
+  if (ok && channel.Flush()) {
+    loop_.WatchWritable(channel.fd(), channel.has_output());
+    return;
+  }
+  loop_.Unwatch(channel.fd());
+  connection_fds_.erase(channel.fd());
+  connections_.erase(connection);
+}
+
+void TeamServer::QueueReplies(std::vector<Reply> &replies) {
+  if (replies.empty()) {
+    return;
+  }
+  bool was_empty;
+  {
+    std::lock_guard lock(replies_mutex_);
+    was_empty = replies_.empty();
+    replies_.insert(replies_.end(), std::make_move_iterator(replies.begin()),
+                    std::make_move_iterator(replies.end()));
+  }
+  replies.clear();
+  if (was_empty) {
+    SignalEventFd(reply_fd_);
+  }
+}
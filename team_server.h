@@ -0,0 +1,94 @@
+#ifndef POMODORO_TEAM_SERVER_H_
+#define POMODORO_TEAM_SERVER_H_
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "channel.h"
+#include "event_loop.h"
+#include "state.pb.h"
+
+// Hosts the pomodoros and todo lists of many users in one process, e.g. of a
+// whole team.
+//
+// Users are sharded over worker threads by a hash of their name. A worker owns
+// its users' State and Pomodoro outright, so commands take no locks beyond
+// the shard's queue. One I/O thread accepts connections, reads TeamRequests
+// and hands them to the shards in batches, and sends the TeamReplies the
+// workers queue back. Each user's StateProto is saved to its own file by a
+// writer thread per shard, which coalesces saves of the same user.
+class TeamServer {
+public:
+  struct Stats {
+    int64_t requests = 0;
+    int64_t users = 0;
+    int64_t saves = 0;
+  };
+
+  // Serves clients connecting to `listen_fd`, which it takes ownership of.
+  // Users are kept in `directory` as "<user>.StateProto.bp", and loaded from
+  // there when they first send a request.
+  TeamServer(int listen_fd, std::string directory, int shards);
+  // Saves every changed user before returning.
+  ~TeamServer();
+  TeamServer(const TeamServer &) = delete;
+  TeamServer &operator=(const TeamServer &) = delete;
+
+  // Serves until `stop_fd` becomes readable, e.g. a signalfd or an eventfd.
+  void Run(int stop_fd);
+
+  Stats stats() const;
+
+  // Whether `user` can be used as a file name.
+  static bool IsValidUser(const std::string &user);
+
+private:
+  struct Shard;
+
+  // Connections are numbered, so that a reply for a closed connection does
+  // not go to a new one that got the same fd.
+  struct Job {
+    uint64_t connection;
+    TeamRequest request;
+  };
+  struct Reply {
+    uint64_t connection;
+    std::string payload;
+  };
+
+  void Accept();
+  // Reads from the connection and adds its requests to `batches`, one per
+  // shard.
+  void Read(uint64_t connection, std::vector<std::vector<Job>> &batches);
+  void SendReplies();
+  // Flushes output and adjusts the writability watch. Drops the connection if
+  // it is gone or `ok` is false.
+  void Update(uint64_t connection, Channel &channel, bool ok);
+  // Called by the workers.
+  void QueueReplies(std::vector<Reply> &replies);
+
+  int listen_fd_;
+  const std::string directory_;
+  std::vector<std::unique_ptr<Shard>> shards_;
+
+  // Owned by the thread in Run().
+  EventLoop loop_;
+  uint64_t next_connection_ = 1;
+  std::unordered_map<uint64_t, std::unique_ptr<Channel>> connections_;
+  std::unordered_map<int, uint64_t> connection_fds_;
+
+  // Replies from the workers. `reply_fd_` is an eventfd that is signaled when
+  // the queue stops being empty.
+  std::mutex replies_mutex_;
+  std::vector<Reply> replies_;
+  int reply_fd_;
+
+  std::atomic<int64_t> requests_ = 0;
+};
+
+#endif // POMODORO_TEAM_SERVER_H_
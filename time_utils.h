@@ -1,42 +1,159 @@
 #ifndef POMODORO_TIME_UTILS_H_
 #define POMODORO_TIME_UTILS_H_
 
+#include <algorithm>
 #include <chrono>
-#include <iomanip>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
 #include <optional>
-#include <sstream>
+#include <string>
 
 #include "state.pb.h"
 
-class Timer {
-private:
-  // Useful for testing.
+// Where timers read the current time, so that they can run on something other
+// than the real clocks.
+class TimeSource {
+public:
+  virtual ~TimeSource() = default;
+
+  // Monotonic time, for measuring durations and scheduling wakeups.
+  virtual std::chrono::steady_clock::time_point SteadyNow() const = 0;
+  // Wall time, for when a Done started and ended.
+  virtual std::chrono::system_clock::time_point SystemNow() const = 0;
+  // Timer seconds per second of these clocks.
+  virtual double time_scale() const = 0;
+};
+
+// The real clocks, sped up by kTimeAcceleration.
+class RealClock : public TimeSource {
+public:
+  // Timer seconds per real second. Useful for testing.
   static constexpr double kTimeAcceleration = 100;
 
+  static const RealClock &Get() {
+    static const RealClock clock;
+    return clock;
+  }
+
+  std::chrono::steady_clock::time_point SteadyNow() const override {
+    return std::chrono::steady_clock::now();
+  }
+  std::chrono::system_clock::time_point SystemNow() const override {
+    return std::chrono::system_clock::now();
+  }
+  double time_scale() const override { return kTimeAcceleration; }
+};
+
+// Clocks that only move when told to, starting at `start` wall time. Both
+// clocks move together and timer seconds are real seconds.
+class SimulatedClock : public TimeSource {
 public:
-  void Start() { start_ = Clock::now(); }
-  double ElapsedSeconds() const {
-    if (!start_)
-      return 0;
-    const std::chrono::duration<double> duration = Clock::now() - *start_;
-    return duration.count() * kTimeAcceleration;
+  explicit SimulatedClock(std::chrono::system_clock::time_point start)
+      : start_(start) {}
+
+  std::chrono::steady_clock::time_point SteadyNow() const override {
+    return std::chrono::steady_clock::time_point(elapsed_);
+  }
+  std::chrono::system_clock::time_point SystemNow() const override {
+    return start_ +
+           std::chrono::duration_cast<std::chrono::system_clock::duration>(
+               elapsed_);
+  }
+  double time_scale() const override { return 1; }
+
+  void Advance(std::chrono::steady_clock::duration duration) {
+    elapsed_ += duration;
+  }
+  // Moves to `time` of SteadyNow(), unless that is in the past.
+  void AdvanceTo(std::chrono::steady_clock::time_point time) {
+    elapsed_ = std::max(elapsed_, time.time_since_epoch());
   }
-  void Reset() { start_ = std::nullopt; }
 
 private:
+  std::chrono::system_clock::time_point start_;
+  std::chrono::steady_clock::duration elapsed_{};
+};
+
+class Timer {
+public:
   // Special clock that always runs forward.
   using Clock = std::chrono::steady_clock;
   using TimePoint = std::chrono::time_point<Clock>;
 
+  explicit Timer(const TimeSource &clock = RealClock::Get()) : clock_(&clock) {}
+
+  void Start() { start_ = clock_->SteadyNow(); }
+  double ElapsedSeconds() const {
+    if (!start_)
+      return 0;
+    const std::chrono::duration<double> duration =
+        clock_->SteadyNow() - *start_;
+    return duration.count() * clock_->time_scale();
+  }
+  void Reset() { start_ = std::nullopt; }
+  // Continues as if started `elapsed_seconds` ago.
+  void Resume(double elapsed_seconds) {
+    const std::chrono::duration<double> real(elapsed_seconds /
+                                             clock_->time_scale());
+    start_ = clock_->SteadyNow() - std::chrono::round<Clock::duration>(real);
+  }
+
+  // The point in time at which ElapsedSeconds() reaches `seconds`.
+  std::optional<TimePoint> TimeAtElapsed(double seconds) const {
+    if (!start_)
+      return std::nullopt;
+    const std::chrono::duration<double> real(seconds / clock_->time_scale());
+    return *start_ + std::chrono::ceil<Clock::duration>(real);
+  }
+
+private:
+  const TimeSource *clock_;
   std::optional<TimePoint> start_;
 };
 
+inline int64_t ToEpochMicros(std::chrono::system_clock::time_point time) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+             time.time_since_epoch())
+      .count();
+}
+
+// Offset of local time from UTC at `time_us`, including daylight saving time.
+inline int32_t UtcOffsetSeconds(int64_t time_us) {
+  const std::time_t time = time_us / 1000000;
+  std::tm local;
+  localtime_r(&time, &local);
+  return local.tm_gmtoff;
+}
+
+// "HH:MM" of the local time that was current at `time_us`. Pure arithmetic,
+// so formatting for display needs no time zone lookup.
+inline std::string FormatClock(int64_t time_us, int32_t utc_offset_seconds) {
+  constexpr int64_t kSecondsPerDay = 24 * 60 * 60;
+  int64_t seconds = time_us / 1000000;
+  if (time_us % 1000000 < 0) {
+    --seconds;
+  }
+  seconds += utc_offset_seconds;
+  const int64_t second_of_day =
+      (seconds % kSecondsPerDay + kSecondsPerDay) % kSecondsPerDay;
+  char buf[sizeof "23:59"];
+  std::snprintf(buf, sizeof buf, "%02d:%02d",
+                static_cast<int>(second_of_day / 3600),
+                static_cast<int>(second_of_day / 60 % 60));
+  return buf;
+}
+
 class PomodoroTimer {
 public:
+  explicit PomodoroTimer(const TimeSource &clock = RealClock::Get())
+      : clock_(&clock), timer_(clock) {}
+
   void Start(double target_duration) {
     target_duration_seconds_ = target_duration;
     has_rung_ = false;
-    start_ = Clock::now();
+    start_ = clock_->SystemNow();
     timer_.Start();
   }
 
@@ -44,8 +161,9 @@ public:
     Done done;
     if (!start_)
       return done;
-    done.set_start_time(FormatTime(*start_));
-    done.set_end_time(FormatTime(Clock::now()));
+    done.set_start_time_us(ToEpochMicros(*start_));
+    done.set_end_time_us(ToEpochMicros(clock_->SystemNow()));
+    done.set_utc_offset_seconds(UtcOffsetSeconds(done.start_time_us()));
     done.set_duration_seconds(timer_.ElapsedSeconds());
 
     start_ = std::nullopt;
@@ -55,6 +173,27 @@ public:
 
   bool active() const { return !!start_; }
 
+  // Stores the timer in `status`, to continue it elsewhere with Resume().
+  void Save(PomodoroStatus *status) const {
+    status->set_target_duration_seconds(target_duration_seconds_);
+    status->set_has_rung(has_rung_);
+    if (start_) {
+      status->set_elapsed_seconds(timer_.ElapsedSeconds());
+      status->set_start_time_us(ToEpochMicros(*start_));
+    }
+  }
+  void Resume(const PomodoroStatus &status) {
+    target_duration_seconds_ = status.target_duration_seconds();
+    has_rung_ = status.has_rung();
+    if (status.has_elapsed_seconds()) {
+      start_ = TimePoint(std::chrono::microseconds(status.start_time_us()));
+      timer_.Resume(status.elapsed_seconds());
+    } else {
+      start_ = std::nullopt;
+      timer_.Reset();
+    }
+  }
+
   double ElapsedSeconds() const { return timer_.ElapsedSeconds(); }
   double ElapsedFraction() const {
     return timer_.ElapsedSeconds() / target_duration_seconds_;
@@ -66,6 +205,28 @@ public:
     return std::max(0.0, timer_.ElapsedSeconds() - target_duration_seconds_);
   }
 
+  // When the remaining or overtime seconds, rounded to whole seconds, change
+  // next.
+  std::optional<Timer::TimePoint> NextSecondChange() const {
+    const double phase = target_duration_seconds_ + 0.5;
+    const double elapsed = timer_.ElapsedSeconds();
+    return timer_.TimeAtElapsed(phase + std::floor(elapsed - phase) + 1);
+  }
+
+  // When ElapsedFraction() * steps reaches the next whole number, e.g. when a
+  // progress bar `steps` cells wide grows by one cell.
+  std::optional<Timer::TimePoint> NextFractionStep(int steps) const {
+    if (steps <= 0)
+      return std::nullopt;
+    const double step = std::floor(ElapsedFraction() * steps) + 1;
+    return timer_.TimeAtElapsed(target_duration_seconds_ * step / steps);
+  }
+
+  // When the timer starts ringing.
+  std::optional<Timer::TimePoint> Deadline() const {
+    return timer_.TimeAtElapsed(target_duration_seconds_);
+  }
+
   // Only returns true once, when called after the time is up.
   bool IsRinging() {
     if (has_rung_) {
@@ -82,18 +243,89 @@ private:
   using Clock = std::chrono::system_clock;
   using TimePoint = std::chrono::time_point<Clock>;
 
+  const TimeSource *clock_;
   Timer timer_;
   double target_duration_seconds_ = 0;
   bool has_rung_ = false;
   std::optional<TimePoint> start_;
+};
 
-  static std::string FormatTime(const TimePoint &time_point) {
-    const std::time_t now_c = std::chrono::system_clock::to_time_t(time_point);
-    const std::tm now_tm = *std::localtime(&now_c);
-    std::stringstream stream;
-    stream << std::put_time(&now_tm, "%H:%M");
-    return stream.str();
+// Days since 1970-01-01 of a "YYYY-MM-DD" day as returned by GetDay().
+inline std::optional<int> ParseDay(const std::string &day) {
+  int y;
+  unsigned m, d;
+  if (std::sscanf(day.c_str(), "%d-%u-%u", &y, &m, &d) != 3) {
+    return std::nullopt;
   }
-};
+  const std::chrono::year_month_day ymd{std::chrono::year{y},
+                                        std::chrono::month{m},
+                                        std::chrono::day{d}};
+  if (!ymd.ok()) {
+    return std::nullopt;
+  }
+  return std::chrono::sys_days{ymd}.time_since_epoch().count();
+}
+
+// Inverse of ParseDay().
+inline std::string FormatDay(int day_number) {
+  const std::chrono::year_month_day ymd{
+      std::chrono::sys_days{std::chrono::days{day_number}}};
+  // Years may have more than four digits, or a sign.
+  char buf[32];
+  std::snprintf(buf, sizeof buf, "%04d-%02u-%02u", static_cast<int>(ymd.year()),
+                static_cast<unsigned>(ymd.month()),
+                static_cast<unsigned>(ymd.day()));
+  return buf;
+}
+
+// Fills start_time_us, end_time_us and utc_offset_seconds of a Done written
+// before those fields existed, from its "HH:MM" strings and the `day` it was
+// recorded on. Done records that already have them are left alone.
+inline void UpgradeDoneTimes(const std::string &day, Done *done) {
+  if (done->has_start_time_us() || !done->has_start_time()) {
+    return;
+  }
+  int year, month, mday;
+  if (std::sscanf(day.c_str(), "%d-%d-%d", &year, &month, &mday) != 3) {
+    return;
+  }
+  const auto to_micros = [&](const std::string &clock,
+                             int32_t *utc_offset) -> std::optional<int64_t> {
+    int hour, minute;
+    if (std::sscanf(clock.c_str(), "%d:%d", &hour, &minute) != 2) {
+      return std::nullopt;
+    }
+    std::tm local = {};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = mday;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    const std::time_t time = std::mktime(&local);
+    if (utc_offset) {
+      *utc_offset = local.tm_gmtoff;
+    }
+    return static_cast<int64_t>(time) * 1000000;
+  };
+
+  int32_t utc_offset = 0;
+  const std::optional<int64_t> start = to_micros(done->start_time(), &utc_offset);
+  std::optional<int64_t> end = to_micros(done->end_time(), nullptr);
+  if (!start) {
+    return;
+  }
+  if (!end) {
+    end = *start + static_cast<int64_t>(done->duration_seconds() * 1e6);
+  } else if (*end < *start) {
+    // Crossed midnight.
+    *end += int64_t{24 * 60 * 60} * 1000000;
+  }
+  done->set_start_time_us(*start);
+  done->set_end_time_us(*end);
+  done->set_utc_offset_seconds(utc_offset);
+  done->clear_start_time();
+  done->clear_end_time();
+}
 
 #endif // POMODORO_TIME_UTILS_H_
@@ -0,0 +1,187 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <bit>
+#include <utility>
+
+#include "trace.h"
+
+namespace {
+
+constexpr int kTickBits = TimerWheel::kLevels * TimerWheel::kLevelBits;
+constexpr uint64_t kLastTick = (uint64_t{1} << kTickBits) - 1;
+
+// The slot of `tick` on `level`.
+int Digit(uint64_t tick, int level) {
+  return (tick >> (level * TimerWheel::kLevelBits)) &
+         (TimerWheel::kSlots - 1);
+}
+
+} // namespace
+
+TimerWheel::TimerWheel(TimePoint now, Clock::duration tick)
+    : origin_(now), tick_(tick) {}
+
+TimerWheel::Id TimerWheel::Schedule(TimePoint deadline,
+                                    std::function<void()> callback) {
+  const Id id = next_id_++;
+  Entry &timer = timers_[id];
+  timer.deadline = ToTick(deadline, /*round_up=*/true);
+  timer.callback = std::move(callback);
+  Insert(id, timer);
+  return id;
+}
+
+bool TimerWheel::Cancel(Id id) {
+  const auto it = timers_.find(id);
+  if (it == timers_.end()) {
+    return false;
+  }
+  Remove(it->second);
+  timers_.erase(it);
+  return true;
+}
+
+int TimerWheel::Advance(TimePoint now) {
+  TRACE_SPAN("TimerWheel::Advance");
+  const uint64_t target = ToTick(now, /*round_up=*/false);
+  std::vector<Id> expired;
+  expired.swap(due_);
+
+  for (std::optional<uint64_t> next = NextEvent(); next && *next <= target;
+       next = NextEvent()) {
+    now_ = *next;
+    // Empty the slots that were reached, from the top, so that timers moving
+    // down can be picked up on the lower levels.
+    for (int level = kLevels - 1; level >= 0; --level) {
+      const int slot = Digit(now_, level);
+      if (!(occupied_[level] >> slot & 1)) {
+        continue;
+      }
+      occupied_[level] &= ~(uint64_t{1} << slot);
+      // Swapping keeps both vectors' capacity for the next time.
+      cascading_.swap(slots_[level][slot]);
+      for (const Id id : cascading_) {
+        Entry &timer = timers_[id];
+        if (timer.deadline <= now_) {
+          expired.push_back(id);
+        } else {
+          Insert(id, timer);
+        }
+      }
+      cascading_.clear();
+    }
+  }
+  now_ = std::max(now_, target);
+
+  for (const Id id : expired) {
+    timers_[id].level = -1;
+  }
+  std::sort(expired.begin(), expired.end(), [&](Id a, Id b) {
+    return std::pair(timers_[a].deadline, a) <
+           std::pair(timers_[b].deadline, b);
+  });
+  int run = 0;
+  for (const Id id : expired) {
+    // An earlier callback may have cancelled it.
+    const auto it = timers_.find(id);
+    if (it == timers_.end()) {
+      continue;
+    }
+    const std::function<void()> callback = std::move(it->second.callback);
+    timers_.erase(it);
+    callback();
+    ++run;
+  }
+  return run;
+}
+
+std::optional<TimerWheel::TimePoint> TimerWheel::NextDeadline() const {
+  if (!due_.empty()) {
+    return FromTick(now_);
+  }
+  // Slots on lower levels are always reached before those on higher levels.
+  for (int level = 0; level < kLevels; ++level) {
+    const std::optional<int> slot = NextSlot(level);
+    if (!slot) {
+      continue;
+    }
+    uint64_t deadline = kLastTick;
+    for (const Id id : slots_[level][*slot]) {
+      deadline = std::min(deadline, timers_.at(id).deadline);
+    }
+    return FromTick(deadline);
+  }
+  return std::nullopt;
+}
+
+uint64_t TimerWheel::ToTick(TimePoint time, bool round_up) const {
+  if (time <= origin_) {
+    return 0;
+  }
+  const Clock::duration since_origin = time - origin_;
+  uint64_t ticks = since_origin / tick_;
+  if (round_up && since_origin % tick_ != Clock::duration::zero()) {
+    ++ticks;
+  }
+  return std::min(ticks, kLastTick);
+}
+
+TimerWheel::TimePoint TimerWheel::FromTick(uint64_t tick) const {
+  return origin_ + static_cast<Clock::rep>(tick) * tick_;
+}
+
+void TimerWheel::Insert(Id id, Entry &timer) {
+  std::vector<Id> *ids;
+  if (timer.deadline <= now_) {
+    timer.level = kLevels;
+    ids = &due_;
+  } else {
+    // The highest digit in which the deadline differs from now. The deadline
+    // is later, so its slot there comes after the current one.
+    timer.level = (std::bit_width(timer.deadline ^ now_) - 1) / kLevelBits;
+    timer.slot = Digit(timer.deadline, timer.level);
+    occupied_[timer.level] |= uint64_t{1} << timer.slot;
+    ids = &slots_[timer.level][timer.slot];
+  }
+  timer.index = ids->size();
+  ids->push_back(id);
+}
+
+void TimerWheel::Remove(const Entry &timer) {
+  if (timer.level < 0) {
+    return;
+  }
+  std::vector<Id> &ids =
+      timer.level == kLevels ? due_ : slots_[timer.level][timer.slot];
+  const Id last = ids.back();
+  ids[timer.index] = last;
+  timers_[last].index = timer.index;
+  ids.pop_back();
+  if (ids.empty() && timer.level < kLevels) {
+    occupied_[timer.level] &= ~(uint64_t{1} << timer.slot);
+  }
+}
+
+std::optional<int> TimerWheel::NextSlot(int level) const {
+  const int current = Digit(now_, level);
+  if (current == kSlots - 1) {
+    return std::nullopt;
+  }
+  const uint64_t later = occupied_[level] & (~uint64_t{0} << (current + 1));
+  if (later == 0) {
+    return std::nullopt;
+  }
+  return std::countr_zero(later);
+}
+
+std::optional<uint64_t> TimerWheel::NextEvent() const {
+  for (int level = 0; level < kLevels; ++level) {
+    if (const std::optional<int> slot = NextSlot(level)) {
+      const int shift = (level + 1) * kLevelBits;
+      return (now_ >> shift << shift) |
+             static_cast<uint64_t>(*slot) << (level * kLevelBits);
+    }
+  }
+  return std::nullopt;
+}
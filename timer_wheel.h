@@ -0,0 +1,92 @@
+#ifndef POMODORO_TIMER_WHEEL_H_
+#define POMODORO_TIMER_WHEEL_H_
+
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+// Runs callbacks at deadlines, for any number of timers: the pomodoro ringing,
+// reminders, timeboxes and the like.
+//
+// Timers sit in a hierarchical wheel of kLevels levels with kSlots slots
+// each. Level 0 has one slot per tick, level 1 one per kSlots ticks, and so
+// on. A timer goes to the lowest level whose slot covers its deadline from
+// now and moves down a level whenever its slot is reached, until it is due.
+// Every level keeps a bitmap of its non-empty slots, so Advance() jumps over
+// empty slots, and its cost grows with the expired and moved timers, not with
+// the number of timers or with the time passed.
+class TimerWheel {
+public:
+  using Clock = std::chrono::steady_clock;
+  using TimePoint = std::chrono::time_point<Clock>;
+  using Id = uint64_t;
+
+  static constexpr int kLevelBits = 6;
+  static constexpr int kSlots = 1 << kLevelBits;
+  // Ticks of 1 ms cover more than 8000 years.
+  static constexpr int kLevels = 8;
+
+  // Time starts at `now`. Deadlines are rounded up to whole ticks, so
+  // callbacks never run early.
+  explicit TimerWheel(TimePoint now,
+                      Clock::duration tick = std::chrono::milliseconds(1));
+  TimerWheel(const TimerWheel &) = delete;
+  TimerWheel &operator=(const TimerWheel &) = delete;
+
+  // Runs `callback` from the first Advance() at or after `deadline`. Returns
+  // an ID for Cancel().
+  Id Schedule(TimePoint deadline, std::function<void()> callback);
+  // Returns false if the timer already ran or was cancelled.
+  bool Cancel(Id id);
+
+  // Moves time forward to `now` and runs the callbacks of the timers that are
+  // due, in deadline order. Callbacks may schedule and cancel timers; those
+  // due right away run on the next call. Returns the number of callbacks run.
+  int Advance(TimePoint now);
+
+  // The earliest deadline, rounded up to a tick, e.g. to sleep until then.
+  std::optional<TimePoint> NextDeadline() const;
+
+  int64_t size() const { return timers_.size(); }
+
+private:
+  struct Entry {
+    uint64_t deadline;
+    std::function<void()> callback;
+    // Where the timer is: level and slot in the wheel, kLevels for due_ or -1
+    // once it expired.
+    int level;
+    int slot;
+    // Index in the slot's vector.
+    int64_t index;
+  };
+
+  // Later times are clamped to the last tick the wheel covers.
+  uint64_t ToTick(TimePoint time, bool round_up) const;
+  TimePoint FromTick(uint64_t tick) const;
+  // Puts the timer into the slot for its deadline, or into due_.
+  void Insert(Id id, Entry &timer);
+  void Remove(const Entry &timer);
+  // The nearest non-empty slot after the current one on `level`, if any.
+  std::optional<int> NextSlot(int level) const;
+  // The next tick at which a slot is reached, if any.
+  std::optional<uint64_t> NextEvent() const;
+
+  TimePoint origin_;
+  Clock::duration tick_;
+  uint64_t now_ = 0;
+  Id next_id_ = 1;
+  std::unordered_map<Id, Entry> timers_;
+  std::array<std::array<std::vector<Id>, kSlots>, kLevels> slots_;
+  std::array<uint64_t, kLevels> occupied_ = {};
+  // Timers whose deadline had already passed when inserted.
+  std::vector<Id> due_;
+  // The slot being emptied in Advance().
+  std::vector<Id> cascading_;
+};
+
+#endif // POMODORO_TIMER_WHEEL_H_
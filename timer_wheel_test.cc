@@ -0,0 +1,205 @@
+#include "timer_wheel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+
+const TimerWheel::TimePoint kOrigin{std::chrono::hours(1000)};
+
+// Ticks of 1 ms that each level covers.
+constexpr int64_t kLevel1 = TimerWheel::kSlots;
+constexpr int64_t kLevel2 = kLevel1 * TimerWheel::kSlots;
+constexpr int64_t kLevel3 = kLevel2 * TimerWheel::kSlots;
+
+TimerWheel::TimePoint At(int64_t ms) { return kOrigin + milliseconds(ms); }
+
+// A wheel that records the order in which its timers run, next to a plain
+// map of the timers that should be pending.
+class TimerWheelTest : public testing::Test {
+protected:
+  TimerWheel::Id Schedule(TimerWheel::TimePoint deadline) {
+    const TimerWheel::Id id =
+        wheel_.Schedule(deadline, [this, n = next_++] { ran_.push_back(n); });
+    // Deadlines are rounded up to whole ticks.
+    const int64_t us =
+        std::chrono::duration_cast<microseconds>(deadline - kOrigin).count();
+    pending_[next_ - 1] = {std::max<int64_t>((us + 999) / 1000, 0), id};
+    return id;
+  }
+
+  bool Cancel(int n) {
+    const auto it = pending_.find(n);
+    if (it == pending_.end()) {
+      return false;
+    }
+    const TimerWheel::Id id = it->second.second;
+    pending_.erase(it);
+    return wheel_.Cancel(id);
+  }
+
+  // Advances both to `ms` and checks that the wheel ran what is due, in
+  // deadline order.
+  void Advance(int64_t ms) {
+    now_ = std::max(now_, ms);
+    std::vector<std::pair<int64_t, int>> due;
+    for (const auto &[n, timer] : pending_) {
+      if (timer.first <= now_) {
+        due.emplace_back(timer.first, n);
+      }
+    }
+    std::sort(due.begin(), due.end());
+    std::vector<int> expected;
+    for (const auto &[deadline, n] : due) {
+      expected.push_back(n);
+      pending_.erase(n);
+    }
+
+    ran_.clear();
+    EXPECT_EQ(wheel_.Advance(At(ms)), static_cast<int>(expected.size()));
+    EXPECT_EQ(ran_, expected) << "at " << ms << " ms";
+    ExpectNextDeadline();
+  }
+
+  void ExpectNextDeadline() {
+    EXPECT_EQ(wheel_.size(), static_cast<int64_t>(pending_.size()));
+    if (pending_.empty()) {
+      EXPECT_EQ(wheel_.NextDeadline(), std::nullopt);
+      return;
+    }
+    int64_t next = pending_.begin()->second.first;
+    for (const auto &[n, timer] : pending_) {
+      next = std::min(next, timer.first);
+    }
+    // Timers that are already due are reported as due now.
+    EXPECT_EQ(wheel_.NextDeadline(), At(std::max(next, now_)));
+  }
+
+  TimerWheel wheel_{kOrigin};
+  int next_ = 0;
+  // By the order of scheduling: deadline in ticks and the wheel's ID.
+  std::map<int, std::pair<int64_t, TimerWheel::Id>> pending_;
+  int64_t now_ = 0;
+  std::vector<int> ran_;
+};
+
+TEST_F(TimerWheelTest, RunsTimersInDeadlineOrder) {
+  Schedule(At(30));
+  Schedule(At(10));
+  Schedule(At(20));
+  Schedule(At(10));
+  Schedule(At(kLevel1 + 1));
+  ExpectNextDeadline();
+  Advance(9);
+  Advance(20);
+  Advance(kLevel2);
+}
+
+TEST_F(TimerWheelTest, RoundsDeadlinesUp) {
+  Schedule(kOrigin + microseconds(1500));
+  Schedule(kOrigin + microseconds(1000));
+  Advance(1);
+  wheel_.Advance(kOrigin + microseconds(1999));
+  EXPECT_EQ(wheel_.size(), 1);
+  Advance(2);
+}
+
+TEST_F(TimerWheelTest, RunsPastDeadlinesOnTheNextAdvance) {
+  Advance(100);
+  Schedule(At(50));
+  Schedule(kOrigin - milliseconds(1));
+  ExpectNextDeadline();
+  Advance(100);
+}
+
+TEST_F(TimerWheelTest, CascadesDownToTheExactTick) {
+  // Each starts on a higher level and moves down as time passes.
+  const int64_t deadlines[] = {kLevel1 + 5, kLevel2 + kLevel1 + 5,
+                               kLevel3 + 3 * kLevel2 + 2 * kLevel1 + 1,
+                               5 * kLevel3};
+  for (const int64_t deadline : deadlines) {
+    Schedule(At(deadline));
+  }
+  for (const int64_t deadline : deadlines) {
+    Advance(deadline - 1);
+    Advance(deadline);
+  }
+}
+
+TEST_F(TimerWheelTest, CancelsCascadedTimers) {
+  const int64_t deadline = 2 * kLevel2 + 7 * kLevel1 + 3;
+  Schedule(At(deadline));
+  Schedule(At(deadline + 1));
+  Schedule(At(deadline + kLevel1));
+  // Past the level 2 slot, so the timers moved down to level 1.
+  Advance(2 * kLevel2);
+  EXPECT_TRUE(Cancel(1));
+  // Past the level 1 slot, so the rest moved down to level 0.
+  Advance(2 * kLevel2 + 7 * kLevel1);
+  EXPECT_TRUE(Cancel(0));
+  EXPECT_FALSE(Cancel(0));
+  Advance(deadline + kLevel1);
+}
+
+TEST_F(TimerWheelTest, CallbacksCanScheduleAndCancel) {
+  TimerWheel wheel(kOrigin);
+  std::vector<int> ran;
+  TimerWheel::Id later = 0;
+  wheel.Schedule(At(10), [&] {
+    ran.push_back(1);
+    wheel.Cancel(later);
+    // Already due, so it runs on the next call.
+    wheel.Schedule(At(5), [&] { ran.push_back(3); });
+  });
+  later = wheel.Schedule(At(11), [&] { ran.push_back(2); });
+  EXPECT_EQ(wheel.Advance(At(20)), 1);
+  EXPECT_EQ(ran, std::vector{1});
+  EXPECT_EQ(wheel.Advance(At(20)), 1);
+  EXPECT_EQ(ran, (std::vector{1, 3}));
+  EXPECT_EQ(wheel.size(), 0);
+}
+
+TEST_F(TimerWheelTest, MatchesAMapOfTimers) {
+  std::mt19937_64 random(1);
+  const int64_t scales[] = {1, kLevel1, kLevel2, kLevel3, 64 * kLevel3};
+  const auto duration = [&] {
+    return static_cast<int64_t>(random() % (scales[random() % 5] * 2));
+  };
+  for (int step = 0; step < 20000; ++step) {
+    switch (random() % 5) {
+    case 0:
+    case 1:
+      // Sometimes before now, or between ticks.
+      Schedule(kOrigin + milliseconds(now_ + duration() - 2) +
+               microseconds(random() % 3 * 400));
+      break;
+    case 2:
+      if (next_ > 0) {
+        const int n = random() % next_;
+        const bool pending = pending_.contains(n);
+        ASSERT_EQ(Cancel(n), pending) << "step " << step;
+      }
+      break;
+    default:
+      Advance(now_ + duration() / 4);
+      break;
+    }
+    if (HasFailure()) {
+      FAIL() << "step " << step;
+    }
+  }
+  Advance(now_ + 1000 * kLevel3);
+  EXPECT_TRUE(pending_.empty());
+}
+
+} // namespace
@@ -0,0 +1,159 @@
+#include "todo_list.h"
+
+#include <bit>
+#include <utility>
+
+namespace {
+
+// Deleted slots are dropped once they outnumber the live ones, but only if
+// there are at least this many.
+constexpr size_t kMinDeadSlotsToRebuild = 64;
+
+} // namespace
+
+void TodoList::LiveCounts::Append(int value) {
+  // Node i covers array indices (i - lowbit(i), i]. Its sum is the new value
+  // plus the nodes i - 1, i - 2, i - 4, ... below lowbit(i), which is O(1)
+  // amortized over all appends.
+  const size_t i = tree_.size();
+  const size_t lowbit = i & -i;
+  int sum = value;
+  for (size_t step = 1; step < lowbit; step <<= 1) {
+    sum += tree_[i - step];
+  }
+  tree_.push_back(sum);
+}
+
+void TodoList::LiveCounts::Add(size_t index, int delta) {
+  for (size_t i = index + 1; i < tree_.size(); i += i & -i) {
+    tree_[i] += delta;
+  }
+}
+
+int TodoList::LiveCounts::Prefix(size_t count) const {
+  int sum = 0;
+  for (size_t i = count; i > 0; i -= i & -i) {
+    sum += tree_[i];
+  }
+  return sum;
+}
+
+size_t TodoList::LiveCounts::FindKth(int k) const {
+  const size_t n = tree_.size() - 1;
+  size_t pos = 0;
+  for (size_t step = std::bit_floor(n); step > 0; step >>= 1) {
+    if (pos + step <= n && tree_[pos + step] < k) {
+      pos += step;
+      k -= tree_[pos];
+    }
+  }
+  // pos is the 1-based index before the k-th live item.
+  return pos;
+}
+
+TodoList::Location TodoList::Locate(size_t position) const {
+  if (position < front_live_) {
+    // front_ is in reverse list order.
+    return {.front = true,
+            .index = front_counts_.FindKth(front_live_ - position)};
+  }
+  return {.front = false,
+          .index = back_counts_.FindKth(position - front_live_ + 1)};
+}
+
+const TodoItem &TodoList::operator[](size_t position) const {
+  return SlotAt(Locate(position)).item;
+}
+
+TodoItem &TodoList::operator[](size_t position) {
+  const Location location = Locate(position);
+  return location.front ? front_[location.index].item
+                        : back_[location.index].item;
+}
+
+const TodoItem *TodoList::Find(uint64_t id) const {
+  const auto it = locations_.find(id);
+  if (it == locations_.end()) {
+    return nullptr;
+  }
+  return &SlotAt(it->second).item;
+}
+
+TodoItem *TodoList::Find(uint64_t id) {
+  return const_cast<TodoItem *>(std::as_const(*this).Find(id));
+}
+
+std::optional<size_t> TodoList::PositionOf(uint64_t id) const {
+  const auto it = locations_.find(id);
+  if (it == locations_.end()) {
+    return std::nullopt;
+  }
+  const Location &location = it->second;
+  if (location.front) {
+    // Live items inserted at the front after this one come before it.
+    return front_live_ - front_counts_.Prefix(location.index + 1);
+  }
+  return front_live_ + back_counts_.Prefix(location.index);
+}
+
+void TodoList::PushFront(TodoItem item) {
+  locations_[item.id] = {.front = true, .index = front_.size()};
+  front_.push_back({.item = std::move(item), .live = true});
+  front_counts_.Append(1);
+  ++front_live_;
+}
+
+void TodoList::PushBack(TodoItem item) {
+  locations_[item.id] = {.front = false, .index = back_.size()};
+  back_.push_back({.item = std::move(item), .live = true});
+  back_counts_.Append(1);
+  ++back_live_;
+}
+
+void TodoList::Erase(size_t position) {
+  if (position >= size()) {
+    return;
+  }
+  const Location location = Locate(position);
+  Slot &slot = location.front ? front_[location.index] : back_[location.index];
+  locations_.erase(slot.item.id);
+  slot.live = false;
+  slot.item.text = std::string();
+  if (location.front) {
+    front_counts_.Add(location.index, -1);
+    --front_live_;
+  } else {
+    back_counts_.Add(location.index, -1);
+    --back_live_;
+  }
+
+  const size_t dead = front_.size() + back_.size() - size();
+  if (dead >= kMinDeadSlotsToRebuild && dead > size()) {
+    RemoveIf([](const TodoItem &) { return false; });
+  }
+}
+
+void TodoList::Clear() { Rebuild({}); }
+
+TodoList::const_iterator TodoList::begin() const {
+  return const_iterator(this, 0);
+}
+
+TodoList::const_iterator TodoList::end() const {
+  return const_iterator(this, front_.size() + back_.size());
+}
+
+void TodoList::Rebuild(std::vector<TodoItem> items) {
+  front_.clear();
+  back_.clear();
+  front_counts_.Clear();
+  back_counts_.Clear();
+  front_live_ = 0;
+  back_live_ = 0;
+  locations_.clear();
+  back_.reserve(items.size());
+  locations_.reserve(items.size());
+  for (TodoItem &item : items) {
+    PushBack(std::move(item));
+  }
+}
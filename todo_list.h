@@ -0,0 +1,158 @@
+#ifndef POMODORO_TODO_LIST_H_
+#define POMODORO_TODO_LIST_H_
+
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct TodoItem {
+  // Stable identity, never reused.
+  uint64_t id = 0;
+  bool done = false;
+  std::string text;
+};
+
+// An ordered list of todos that are identified by stable IDs.
+//
+// Items live in two append-only arrays: one for items inserted at the front,
+// in insertion order, and one for items inserted at the back. Deleted items
+// are only marked. A Fenwick tree per array counts live items, which gives
+// O(log n) positional access, deletion and position lookup by ID. Appending to
+// a Fenwick tree is amortized O(1), and so are PushFront() and PushBack().
+// Once more than half of the slots are deleted, the arrays are rebuilt.
+class TodoList {
+public:
+  class const_iterator;
+
+  size_t size() const { return front_live_ + back_live_; }
+  bool empty() const { return size() == 0; }
+
+  // The item at `position`, counted from the front. O(log n).
+  const TodoItem &operator[](size_t position) const;
+  TodoItem &operator[](size_t position);
+
+  const TodoItem *Find(uint64_t id) const;
+  TodoItem *Find(uint64_t id);
+  // Current position of the item with `id`. O(log n).
+  std::optional<size_t> PositionOf(uint64_t id) const;
+
+  void PushFront(TodoItem item);
+  void PushBack(TodoItem item);
+  void Erase(size_t position);
+  void Clear();
+
+  // Removes all items for which `predicate` returns true. O(n).
+  template <typename Predicate> void RemoveIf(Predicate predicate) {
+    std::vector<TodoItem> kept;
+    kept.reserve(size());
+    for (const TodoItem &item : *this) {
+      if (!predicate(item)) {
+        kept.push_back(item);
+      }
+    }
+    Rebuild(std::move(kept));
+  }
+
+  const_iterator begin() const;
+  const_iterator end() const;
+
+private:
+  struct Slot {
+    TodoItem item;
+    bool live;
+  };
+  struct Location {
+    bool front;
+    size_t index;
+  };
+
+  // 1-based Fenwick tree over the live flags of one array.
+  class LiveCounts {
+  public:
+    void Append(int value);
+    void Add(size_t index, int delta);
+    // Live items at array indices [0, count).
+    int Prefix(size_t count) const;
+    // Array index of the k-th live item, k counted from 1.
+    size_t FindKth(int k) const;
+    void Clear() { tree_.assign(1, 0); }
+
+  private:
+    std::vector<int> tree_ = {0};
+  };
+
+  Location Locate(size_t position) const;
+  const Slot &SlotAt(Location location) const {
+    return location.front ? front_[location.index] : back_[location.index];
+  }
+  void Rebuild(std::vector<TodoItem> items);
+
+  // front_ holds items in insertion order, i.e. the last item is the first
+  // one in the list.
+  std::vector<Slot> front_;
+  std::vector<Slot> back_;
+  LiveCounts front_counts_;
+  LiveCounts back_counts_;
+  size_t front_live_ = 0;
+  size_t back_live_ = 0;
+  std::unordered_map<uint64_t, Location> locations_;
+};
+
+// Visits live items in list order.
+class TodoList::const_iterator {
+public:
+  using iterator_category = std::forward_iterator_tag;
+  using value_type = TodoItem;
+  using difference_type = std::ptrdiff_t;
+  using pointer = const TodoItem *;
+  using reference = const TodoItem &;
+
+  const_iterator() = default;
+
+  reference operator*() const { return list_->SlotAt(location()).item; }
+  pointer operator->() const { return &**this; }
+  const_iterator &operator++() {
+    ++step_;
+    SkipDead();
+    return *this;
+  }
+  const_iterator operator++(int) {
+    const_iterator copy = *this;
+    ++*this;
+    return copy;
+  }
+  bool operator==(const const_iterator &other) const {
+    return step_ == other.step_;
+  }
+
+private:
+  friend class TodoList;
+
+  const_iterator(const TodoList *list, size_t step) : list_(list), step_(step) {
+    SkipDead();
+  }
+
+  // Steps walk front_ backwards, then back_ forwards.
+  Location location() const {
+    const size_t front_size = list_->front_.size();
+    if (step_ < front_size) {
+      return {.front = true, .index = front_size - 1 - step_};
+    }
+    return {.front = false, .index = step_ - front_size};
+  }
+  size_t steps() const { return list_->front_.size() + list_->back_.size(); }
+  void SkipDead() {
+    while (step_ < steps() && !list_->SlotAt(location()).live) {
+      ++step_;
+    }
+  }
+
+  const TodoList *list_ = nullptr;
+  size_t step_ = 0;
+};
+
+#endif // POMODORO_TODO_LIST_H_
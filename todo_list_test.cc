@@ -0,0 +1,141 @@
+#include "todo_list.h"
+
+#include <random>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace {
+
+TodoItem Item(uint64_t id) {
+  return {.id = id, .done = false, .text = "Todo " + std::to_string(id)};
+}
+
+std::vector<uint64_t> Ids(const TodoList &list) {
+  std::vector<uint64_t> ids;
+  for (const TodoItem &item : list) {
+    ids.push_back(item.id);
+  }
+  return ids;
+}
+
+// Checks every way of reading `list` against `model`, and that `deleted` IDs
+// are gone.
+void ExpectEqual(const TodoList &list, const std::vector<TodoItem> &model,
+                 const std::vector<uint64_t> &deleted) {
+  ASSERT_EQ(list.size(), model.size());
+  EXPECT_EQ(list.empty(), model.empty());
+  std::vector<uint64_t> model_ids;
+  for (size_t i = 0; i < model.size(); ++i) {
+    const TodoItem &item = list[i];
+    EXPECT_EQ(item.id, model[i].id) << "position " << i;
+    EXPECT_EQ(item.done, model[i].done) << "position " << i;
+    EXPECT_EQ(item.text, model[i].text) << "position " << i;
+    EXPECT_EQ(list.PositionOf(model[i].id), i);
+    const TodoItem *found = list.Find(model[i].id);
+    ASSERT_NE(found, nullptr);
+    EXPECT_EQ(found->id, model[i].id);
+    model_ids.push_back(model[i].id);
+  }
+  EXPECT_EQ(Ids(list), model_ids);
+  for (const uint64_t id : deleted) {
+    EXPECT_EQ(list.Find(id), nullptr) << "id " << id;
+    EXPECT_EQ(list.PositionOf(id), std::nullopt) << "id " << id;
+  }
+}
+
+TEST(TodoListTest, KeepsOrderOfFrontAndBackInserts) {
+  TodoList list;
+  list.PushBack(Item(1));
+  list.PushFront(Item(2));
+  list.PushBack(Item(3));
+  list.PushFront(Item(4));
+  EXPECT_EQ(Ids(list), (std::vector<uint64_t>{4, 2, 1, 3}));
+  EXPECT_EQ(list.PositionOf(1), 2u);
+
+  list.Erase(1);
+  EXPECT_EQ(Ids(list), (std::vector<uint64_t>{4, 1, 3}));
+  EXPECT_EQ(list.Find(2), nullptr);
+  EXPECT_EQ(list.PositionOf(3), 2u);
+
+  list[0].done = true;
+  EXPECT_TRUE(list.Find(4)->done);
+  list.RemoveIf([](const TodoItem &item) { return item.done; });
+  EXPECT_EQ(Ids(list), (std::vector<uint64_t>{1, 3}));
+
+  list.Clear();
+  EXPECT_TRUE(list.empty());
+  EXPECT_EQ(list.begin(), list.end());
+  EXPECT_EQ(list.Find(1), nullptr);
+}
+
+TEST(TodoListTest, MatchesVectorUnderRandomOperations) {
+  std::mt19937 random(42);
+  TodoList list;
+  std::vector<TodoItem> model;
+  std::vector<uint64_t> deleted;
+  uint64_t next_id = 1;
+  for (int step = 0; step < 4000; ++step) {
+    const int operation = random() % 100;
+    if (operation < 30 || model.empty()) {
+      list.PushBack(Item(next_id));
+      model.push_back(Item(next_id));
+      ++next_id;
+    } else if (operation < 60) {
+      list.PushFront(Item(next_id));
+      model.insert(model.begin(), Item(next_id));
+      ++next_id;
+    } else if (operation < 90) {
+      // Deletes often enough to trigger rebuilds.
+      const size_t position = random() % model.size();
+      deleted.push_back(model[position].id);
+      list.Erase(position);
+      model.erase(model.begin() + position);
+    } else if (operation < 97) {
+      const size_t position = random() % model.size();
+      list[position].done = !list[position].done;
+      model[position].done = !model[position].done;
+    } else {
+      for (const TodoItem &item : model) {
+        if (item.done) {
+          deleted.push_back(item.id);
+        }
+      }
+      list.RemoveIf([](const TodoItem &item) { return item.done; });
+      std::erase_if(model, [](const TodoItem &item) { return item.done; });
+    }
+    if (step % 50 == 0) {
+      ASSERT_NO_FATAL_FAILURE(ExpectEqual(list, model, deleted))
+          << "step " << step;
+    }
+  }
+  ExpectEqual(list, model, deleted);
+}
+
+TEST(TodoListTest, SurvivesDeletingAlmostEverything) {
+  TodoList list;
+  std::vector<TodoItem> model;
+  std::vector<uint64_t> deleted;
+  for (uint64_t id = 1; id <= 1000; ++id) {
+    if (id % 2 == 0) {
+      list.PushFront(Item(id));
+      model.insert(model.begin(), Item(id));
+    } else {
+      list.PushBack(Item(id));
+      model.push_back(Item(id));
+    }
+  }
+  while (model.size() > 1) {
+    const size_t position = model.size() / 3;
+    deleted.push_back(model[position].id);
+    list.Erase(position);
+    model.erase(model.begin() + position);
+  }
+  ExpectEqual(list, model, deleted);
+  list.PushFront(Item(1001));
+  model.insert(model.begin(), Item(1001));
+  ExpectEqual(list, model, deleted);
+}
+
+} // namespace
@@ -0,0 +1,103 @@
+#include "trace.h"
+
+#ifdef POMODORO_TRACING
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct Span {
+  const char *name;
+  std::chrono::steady_clock::time_point begin;
+  std::chrono::steady_clock::time_point end;
+};
+
+// The spans of one thread. Only that thread adds to it, the mutex is only
+// contended while the trace is written.
+struct TraceBuffer {
+  std::mutex mutex;
+  int thread_id;
+  // Spans ever added. The latest kTraceBufferSpans are kept.
+  uint64_t added = 0;
+  std::array<Span, kTraceBufferSpans> spans;
+};
+
+// Buffers outlive their threads, so spans of finished threads are written
+// too.
+std::mutex buffers_mutex;
+std::vector<std::shared_ptr<TraceBuffer>> buffers;
+
+TraceBuffer &ThreadBuffer() {
+  thread_local std::shared_ptr<TraceBuffer> buffer = [] {
+    auto buffer = std::make_shared<TraceBuffer>();
+    std::lock_guard<std::mutex> lock(buffers_mutex);
+    buffer->thread_id = buffers.size() + 1;
+    buffers.push_back(buffer);
+    return buffer;
+  }();
+  return *buffer;
+}
+
+int64_t Microseconds(std::chrono::steady_clock::duration duration) {
+  return std::chrono::duration_cast<std::chrono::microseconds>(duration)
+      .count();
+}
+
+} // namespace
+
+TraceSpan::~TraceSpan() {
+  const auto end = std::chrono::steady_clock::now();
+  TraceBuffer &buffer = ThreadBuffer();
+  std::lock_guard<std::mutex> lock(buffer.mutex);
+  buffer.spans[buffer.added % kTraceBufferSpans] = {name_, begin_, end};
+  ++buffer.added;
+}
+
+void WriteTrace(const std::string &path) {
+  std::ofstream os(path);
+  if (!os.is_open()) {
+    std::cout << "Could not write to '" << path << "'.\n";
+    return;
+  }
+
+  std::lock_guard<std::mutex> buffers_lock(buffers_mutex);
+  // Timestamps are relative to the earliest kept span.
+  auto origin = std::chrono::steady_clock::time_point::max();
+  for (const auto &buffer : buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    const uint64_t first = buffer->added > kTraceBufferSpans
+                               ? buffer->added - kTraceBufferSpans
+                               : 0;
+    if (first < buffer->added) {
+      origin = std::min(origin, buffer->spans[first % kTraceBufferSpans].begin);
+    }
+  }
+
+  os << "{\"traceEvents\":[";
+  bool first_event = true;
+  for (const auto &buffer : buffers) {
+    std::lock_guard<std::mutex> lock(buffer->mutex);
+    const uint64_t first = buffer->added > kTraceBufferSpans
+                               ? buffer->added - kTraceBufferSpans
+                               : 0;
+    for (uint64_t i = first; i < buffer->added; ++i) {
+      const Span &span = buffer->spans[i % kTraceBufferSpans];
+      // Span names are literals in our code and need no escaping.
+      os << (first_event ? "\n" : ",\n") << "{\"name\":\"" << span.name
+         << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << buffer->thread_id
+         << ",\"ts\":" << Microseconds(span.begin - origin)
+         << ",\"dur\":" << Microseconds(span.end - span.begin) << "}";
+      first_event = false;
+    }
+  }
+  os << "\n]}\n";
+}
+
+#endif // POMODORO_TRACING
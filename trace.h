@@ -0,0 +1,56 @@
+#ifndef POMODORO_TRACE_H_
+#define POMODORO_TRACE_H_
+
+#include <chrono>
+#include <string>
+
+// Trace spans for profiling real sessions, compiled out unless
+// POMODORO_TRACING is defined, e.g. with --copt=-DPOMODORO_TRACING.
+//
+//   void Draw() {
+//     TRACE_SPAN("Draw");
+//     ...
+//   }
+//
+// Every thread records its spans into its own ring buffer, which keeps the
+// latest kTraceBufferSpans spans. WriteTrace() dumps all of them as a Chrome
+// trace, which chrome://tracing and ui.perfetto.dev open.
+
+#ifdef POMODORO_TRACING
+
+constexpr int kTraceBufferSpans = 1 << 16;
+
+// Records the time from its construction to its destruction. `name` must
+// outlive the trace, e.g. be a string literal.
+class TraceSpan {
+public:
+  explicit TraceSpan(const char *name)
+      : name_(name), begin_(std::chrono::steady_clock::now()) {}
+  ~TraceSpan();
+  TraceSpan(const TraceSpan &) = delete;
+  TraceSpan &operator=(const TraceSpan &) = delete;
+
+private:
+  const char *name_;
+  std::chrono::steady_clock::time_point begin_;
+};
+
+#define POMODORO_TRACE_CONCAT_(a, b) a##b
+#define POMODORO_TRACE_CONCAT(a, b) POMODORO_TRACE_CONCAT_(a, b)
+#define TRACE_SPAN(name)                                                       \
+  const TraceSpan POMODORO_TRACE_CONCAT(trace_span_, __LINE__)(name)
+
+// Writes the spans of all threads to `path` as Chrome trace JSON.
+void WriteTrace(const std::string &path);
+
+#else
+
+#define TRACE_SPAN(name)                                                       \
+  do {                                                                         \
+  } while (false)
+
+inline void WriteTrace(const std::string &) {}
+
+#endif // POMODORO_TRACING
+
+#endif // POMODORO_TRACE_H_
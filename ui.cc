@@ -0,0 +1,40 @@
+#include "ui.h"
+
+#include "ncurses.h"
+
+void init_colors() {
+  start_color();
+  init_pair(Color::DEFAULT, COLOR_WHITE, COLOR_BLACK);
+  init_pair(Color::BAR, COLOR_BLACK, COLOR_GREEN);
+  init_pair(Color::PAUSE_BAR, COLOR_BLACK, COLOR_BLUE);
+  init_pair(Color::PAUSE_OVER_BAR, COLOR_BLACK, COLOR_YELLOW);
+
+  init_pair(Color::WORK_BLOCK, COLOR_BLACK, COLOR_GREEN);
+  init_pair(Color::PAUSE_BLOCK, COLOR_WHITE, COLOR_BLACK);
+}
+
+void DrawToday(Screen &screen, const State &state) {
+  TRACE_SPAN("DrawToday");
+  Style style;
+  const std::vector<State::Phase> &phases = state.phases();
+  // Every phase takes at least three cells, so the screen is full after
+  // `fitting` of them. Later ones only overwrite the bottom right cell, which
+  // the last of them ends up with, so the others are skipped.
+  const size_t fitting = screen.rows() * screen.cols() / 3 + 1;
+  for (size_t i = 0; i < phases.size(); ++i) {
+    if (i == fitting) {
+      i = phases.size() - 1;
+    }
+    const State::Phase &phase = phases[i];
+    const int duration_minutes = std::lround(phase.duration_seconds / 60);
+
+    if (phase.type == Done::WORK) {
+      style.color = Color::WORK_BLOCK;
+    } else if (phase.type == Done::BREAK) {
+      style.color = Color::PAUSE_BLOCK;
+    }
+    char buffer[16];
+    const int length = snprintf(buffer, sizeof buffer, " %d ", duration_minutes);
+    screen.Append(std::string_view(buffer, length), style);
+  }
+}
@@ -0,0 +1,638 @@
+#ifndef POMODORO_UI_H_
+#define POMODORO_UI_H_
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "screen.h"
+#include "state.h"
+#include "state.pb.h"
+#include "time_utils.h"
+#include "timer_wheel.h"
+#include "trace.h"
+
+constexpr double kWorkPhaseSeconds = 25 * 60;
+constexpr double kShortBreakSeconds = 5 * 60;
+constexpr double kLongBreakSeconds = 15 * 60;
+
+enum Color {
+  DEFAULT = 1,
+  BAR = 2,
+  PAUSE_BAR = 3,
+  PAUSE_OVER_BAR = 4,
+
+  WORK_BLOCK = 5,
+  PAUSE_BLOCK = 6,
+};
+
+void init_colors();
+
+class Todo {
+public:
+  Todo(State &state) : state_(state) {}
+
+  void Up() { current_item = std::max(current_item - 1, 0); }
+
+  void Down() {
+    current_item = std::min<int>(current_item + 1, ItemCount() - 1);
+    current_item = std::max(current_item, 0);
+  }
+
+  std::string CurrentTodoText() const {
+    const TodoItem *item = ItemAt(current_item);
+    return item ? item->text : "";
+  }
+
+  // ID of the current todo, 0 if the list is empty.
+  uint64_t CurrentTodoId() const {
+    const TodoItem *item = ItemAt(current_item);
+    return item ? item->id : 0;
+  }
+
+  int current() const { return current_item; }
+
+  void Toggle() {
+    if (const std::optional<size_t> position = CurrentPosition()) {
+      state_.ToggleTodo(*position);
+    }
+  }
+
+  // Draws only the items that fit into `screen`, one per row, scrolled so that
+  // the current item is visible. While filtered, the query is shown in the
+  // first row.
+  void Draw(Screen &screen) {
+    TRACE_SPAN("Todo::Draw");
+    DropDeletedFromFilter();
+    const int header_rows = filter_ ? 1 : 0;
+    if (filter_) {
+      screen.Print(0, 0, "/", Style());
+      screen.Append(query_, {.attributes = Style::kBold});
+    }
+
+    const int rows = screen.rows() - header_rows;
+    ScrollToCurrent(rows);
+    const int text_width = std::max(screen.cols() - 4, 0);
+    const int end = std::min(ItemCount(), first_visible_ + rows);
+    for (int i = first_visible_; i < end; ++i) {
+      const TodoItem *item = ItemAt(i);
+      if (!item) {
+        continue;
+      }
+
+      Style style;
+      if (i == current_item) {
+        style.attributes |= Style::kBold;
+      }
+      if (item->done) {
+        style.attributes |= Style::kDim;
+      }
+
+      const int row = header_rows + i - first_visible_;
+      screen.Print(row, 0, item->done ? "[x] " : "[ ] ", style);
+      std::string_view text = item->text;
+      if (text.size() > static_cast<size_t>(text_width)) {
+        // Cut before a UTF-8 character rather than within one, whose
+        // continuation bytes are 0b10xxxxxx.
+        size_t cut = text_width;
+        while (cut > 0 && (text[cut] & 0xC0) == 0x80) {
+          --cut;
+        }
+        text = text.substr(0, cut);
+      }
+      screen.Append(text, style);
+    }
+
+    // Move to the current item.
+    screen.Move(header_rows + current_item - first_visible_, 1);
+  }
+
+  // Selects the first item, where New() will put the next todo.
+  void MoveToTop() { current_item = 0; }
+
+  void New(const std::string &text) {
+    current_item = 0;
+    state_.AddTodoFront(text);
+  }
+
+  void Delete() {
+    if (const std::optional<size_t> position = CurrentPosition()) {
+      state_.DeleteTodo(*position);
+    }
+    ClampSelection();
+  }
+
+  // Keeps the selection within the list, e.g. after todos were deleted
+  // elsewhere.
+  void ClampSelection() {
+    DropDeletedFromFilter();
+    current_item = std::min(current_item, ItemCount() - 1);
+    current_item = std::max(current_item, 0);
+  }
+
+  // Selects the todo with `id`, if it is shown.
+  void Select(uint64_t id) {
+    if (filter_) {
+      const auto it = std::find(filter_->begin(), filter_->end(), id);
+      if (it != filter_->end()) {
+        current_item = it - filter_->begin();
+      }
+    } else if (const std::optional<size_t> position =
+                   state_.todos().PositionOf(id)) {
+      current_item = *position;
+    }
+  }
+
+  // Shows only the todos with `ids`, in that order, e.g. the results of
+  // searching for `query`, and selects the first one.
+  void Filter(const std::string &query, std::vector<uint64_t> ids) {
+    if (!filter_) {
+      unfiltered_item_ = current_item;
+    }
+    query_ = query;
+    filter_ = std::move(ids);
+    filtered_todos_version_ = state_.todos_version();
+    current_item = 0;
+    first_visible_ = 0;
+    ++filter_version_;
+  }
+
+  // Shows all todos again. If `keep_selection`, the todo selected in the
+  // filtered list stays selected, otherwise the selection from before
+  // filtering is restored.
+  void ClearFilter(bool keep_selection) {
+    if (!filter_) {
+      return;
+    }
+    const std::optional<size_t> position = CurrentPosition();
+    filter_.reset();
+    current_item = keep_selection && position ? *position : unfiltered_item_;
+    current_item = std::clamp(current_item, 0, std::max(ItemCount() - 1, 0));
+    first_visible_ = 0;
+    ++filter_version_;
+  }
+
+  bool filtered() const { return filter_.has_value(); }
+  // Changes whenever the filter does, so views know when to redraw.
+  uint64_t filter_version() const { return filter_version_; }
+
+private:
+  int ItemCount() const {
+    return filter_ ? filter_->size() : state_.todos().size();
+  }
+
+  // The item in row `index` of the (filtered) list, nullptr if there is none.
+  const TodoItem *ItemAt(int index) const {
+    if (index < 0 || index >= ItemCount()) {
+      return nullptr;
+    }
+    if (filter_) {
+      return state_.todos().Find((*filter_)[index]);
+    }
+    return &state_.todos()[index];
+  }
+
+  // Removes the todos deleted since filtering, e.g. by another client, from
+  // the filter, so that they leave no blank rows. The selection stays on its
+  // todo, or moves to the next one if that was deleted.
+  void DropDeletedFromFilter() {
+    if (!filter_ || filtered_todos_version_ == state_.todos_version()) {
+      return;
+    }
+    filtered_todos_version_ = state_.todos_version();
+    const TodoList &todos = state_.todos();
+    int removed_before_current = 0;
+    for (int i = 0; i < std::min<int>(current_item, filter_->size()); ++i) {
+      removed_before_current += todos.Find((*filter_)[i]) ? 0 : 1;
+    }
+    const size_t size = filter_->size();
+    std::erase_if(*filter_, [&todos](uint64_t id) { return !todos.Find(id); });
+    if (filter_->size() == size) {
+      return;
+    }
+    current_item -= removed_before_current;
+    current_item = std::clamp(current_item, 0,
+                              std::max<int>(filter_->size() - 1, 0));
+    ++filter_version_;
+  }
+
+  // Position of the current item in the unfiltered list.
+  std::optional<size_t> CurrentPosition() const {
+    if (!filter_) {
+      if (current_item < ItemCount()) {
+        return current_item;
+      }
+      return std::nullopt;
+    }
+    const TodoItem *item = ItemAt(current_item);
+    return item ? state_.todos().PositionOf(item->id) : std::nullopt;
+  }
+
+  // Adjusts the scroll offset as little as possible to show the current item
+  // in a window of `rows` rows, without leaving empty rows at the bottom.
+  void ScrollToCurrent(int rows) {
+    if (rows <= 0) {
+      return;
+    }
+    if (current_item < first_visible_) {
+      first_visible_ = current_item;
+    } else if (current_item >= first_visible_ + rows) {
+      first_visible_ = current_item - rows + 1;
+    }
+    const int last_page = std::max(ItemCount() - rows, 0);
+    first_visible_ = std::clamp(first_visible_, 0, last_page);
+  }
+
+  State &state_;
+  int current_item = 0;
+  // Index of the item in the top row.
+  int first_visible_ = 0;
+
+  // IDs of the todos shown while filtered.
+  std::optional<std::vector<uint64_t>> filter_;
+  std::string query_;
+  // current_item before filtering.
+  int unfiltered_item_ = 0;
+  uint64_t filter_version_ = 0;
+  // State::todos_version() when the filter last lost its deleted todos.
+  uint64_t filtered_todos_version_ = 0;
+};
+
+class Pomodoro {
+public:
+  Pomodoro(State &state, Todo &todo, const TimeSource &clock = RealClock::Get())
+      : Pomodoro(state, todo, clock,
+                 std::make_unique<TimerWheel>(clock.SteadyNow()), nullptr,
+                 nullptr) {}
+  // Rings from `timers`, which the caller advances, e.g. one wheel for all the
+  // pomodoros of a server. Calls `on_ring` when the running block finishes,
+  // instead of returning true from Tick(). `timers` must outlive the Pomodoro.
+  Pomodoro(State &state, Todo &todo, TimerWheel &timers,
+           std::function<void()> on_ring,
+           const TimeSource &clock = RealClock::Get())
+      : Pomodoro(state, todo, clock, nullptr, &timers, std::move(on_ring)) {}
+  ~Pomodoro() { CancelRing(); }
+  Pomodoro(const Pomodoro &) = delete;
+  Pomodoro &operator=(const Pomodoro &) = delete;
+
+  // Start the next work or break unit. If work or break is already running, do
+  // nothing.
+  void Start() {
+    const WorkState previous = work_state;
+    switch (work_state) {
+    case WORKING:
+    case PAUSE:
+      // Timer is already running. Do nothing.
+      break;
+    case WORK_DONE:
+      FinishWork();
+      work_state = PAUSE;
+      if (pomodoros_done >= 4) {
+        pomodoros_done = 0;
+        // Time for a long break, YAY!
+        timer_.Start(kLongBreakSeconds);
+      } else {
+        timer_.Start(kShortBreakSeconds);
+      }
+      ScheduleRing();
+      break;
+    case PAUSE_DONE:
+      FinishPause();
+      work_state = WORKING;
+      timer_.Start(kWorkPhaseSeconds);
+      ScheduleRing();
+      break;
+    }
+    if (work_state != previous) {
+      state_.SetPomodoro(Status());
+    }
+  }
+
+  void Stop() {
+    CancelRing();
+    const WorkState previous = work_state;
+    // "Force" current phase to end, so it's possible to start the next one.
+    switch (work_state) {
+    case WORKING:
+      work_state = WORK_DONE;
+      break;
+    case PAUSE:
+      work_state = PAUSE_DONE;
+      break;
+    case WORK_DONE:
+    case PAUSE_DONE:
+      // Nothing to do.
+      break;
+    }
+    if (work_state != previous) {
+      state_.SetPomodoro(Status());
+    }
+  }
+
+  void FinishPause() {
+    if (work_state != PAUSE_DONE || !timer_.active()) {
+      return;
+    }
+    Done done = timer_.Stop();
+    done.set_done_type(Done::BREAK);
+    state_.AddDone(done, Status());
+  }
+
+  void FinishWork() {
+    if (work_state != WORK_DONE || !timer_.active()) {
+      return;
+    }
+    pomodoros_done += 1;
+    Done done = timer_.Stop();
+    done.set_done_type(Done::WORK);
+    done.set_todo(todo_.CurrentTodoText());
+    done.set_todo_id(todo_.CurrentTodoId());
+    state_.AddDone(done, Status());
+  }
+
+  // Books finished work and drops the rest of a running block, which cannot
+  // go on without the process. Journaled, so the next start does not continue
+  // the block.
+  void Quit() {
+    FinishWork();
+    CancelRing();
+    if (work_state == WORKING) {
+      work_state = PAUSE_DONE;
+    } else if (work_state == PAUSE) {
+      work_state = WORK_DONE;
+    }
+    if (timer_.active()) {
+      timer_.Stop();
+    }
+    state_.SetPomodoro(Status());
+  }
+
+  void Reset() {
+    CancelRing();
+    const WorkState previous = work_state;
+    switch (work_state) {
+    case PAUSE_DONE:
+      // Nothing to reset.
+      break;
+    case WORK_DONE:
+    case WORKING: {
+      work_state = PAUSE_DONE;
+      break;
+    }
+    case PAUSE: {
+      work_state = WORK_DONE;
+      break;
+    }
+    }
+    if (work_state != previous) {
+      state_.SetPomodoro(Status());
+    }
+  }
+
+  // Runs the timers that are due, including the running block ringing.
+  // Returns true if the current block just finished, so the caller can beep.
+  bool Tick() {
+    TRACE_SPAN("Pomodoro::Tick");
+    if (own_timers_) {
+      own_timers_->Advance(clock_.SteadyNow());
+    }
+    return std::exchange(rang_, false);
+  }
+
+  // Reminders, timeboxes and other timers to run alongside the pomodoro. They
+  // run from Tick() and count towards NextDeadline() and NextUpdate().
+  TimerWheel &timers() { return *timers_; }
+
+  // When Tick() next has something to do.
+  std::optional<Timer::TimePoint> NextDeadline() const {
+    return timers_->NextDeadline();
+  }
+
+  // When the drawn timer changes next without any input: the displayed seconds,
+  // the bar length or the timer ringing, or when a timer is due. Nothing is
+  // drawn differently after a pause is over. `width` is the width of the bar in
+  // cells.
+  std::optional<Timer::TimePoint> NextUpdate(int width) const {
+    std::optional<Timer::TimePoint> next = timers_->NextDeadline();
+    const auto consider = [&next](std::optional<Timer::TimePoint> candidate) {
+      if (candidate && (!next || *candidate < *next)) {
+        next = candidate;
+      }
+    };
+    switch (work_state) {
+    case PAUSE_DONE:
+      break;
+    case WORK_DONE:
+      consider(timer_.NextSecondChange());
+      break;
+    case WORKING:
+    case PAUSE:
+      consider(timer_.NextSecondChange());
+      consider(timer_.NextFractionStep(width));
+      break;
+    }
+    return next;
+  }
+
+  // When Tick() next returns true, if a block is running.
+  std::optional<Timer::TimePoint> RingTime() const {
+    if (work_state == WORKING || work_state == PAUSE) {
+      return timer_.Deadline();
+    }
+    return std::nullopt;
+  }
+
+  // Everything needed to continue the pomodoro in another process.
+  PomodoroStatus Status() const {
+    PomodoroStatus status;
+    // WorkState has the same order as PomodoroStatus::WorkState.
+    status.set_work_state(static_cast<PomodoroStatus::WorkState>(work_state));
+    status.set_pomodoros_done(pomodoros_done);
+    timer_.Save(&status);
+    return status;
+  }
+
+  // Continues from a Status() of another process. Returns true if that
+  // finished the running block because the time was up, so the caller can
+  // beep.
+  bool Restore(const PomodoroStatus &status) {
+    const bool was_running = work_state == WORKING || work_state == PAUSE;
+    work_state = static_cast<WorkState>(status.work_state());
+    pomodoros_done = status.pomodoros_done();
+    timer_.Resume(status);
+    CancelRing();
+    if ((work_state == WORKING || work_state == PAUSE) && !status.has_rung()) {
+      ScheduleRing();
+    }
+    return was_running && status.has_rung() &&
+           (work_state == WORK_DONE || work_state == PAUSE_DONE);
+  }
+
+  // Everything Draw() puts on screen. Equal views draw the same.
+  struct View {
+    std::string text;
+    int bar_length;
+    short bar_color;
+    int pomodoros_done;
+
+    bool operator==(const View &) const = default;
+  };
+
+  View GetView(int width) const {
+    int bar_length = timer_.ElapsedFraction() * width;
+    bar_length = std::min(bar_length, width);
+    bar_length = std::max(bar_length, 1);
+    if (work_state == WORK_DONE || work_state == PAUSE_DONE) {
+      bar_length = width;
+    }
+
+    const int remaining = std::lround(timer_.RemainingSeconds());
+    constexpr int kBufSize = 32;
+    char buffer[kBufSize];
+    short bar_color = Color::BAR;
+    switch (work_state) {
+    case WORKING:
+      snprintf(buffer, kBufSize, "work %2d:%02d", remaining / 60,
+               remaining % 60);
+      bar_color = Color::BAR;
+      break;
+    case WORK_DONE: {
+      const int overtime = std::lround(timer_.OvertimeSeconds());
+      snprintf(buffer, kBufSize, "work DONE (+%d:%02d)", overtime / 60,
+               overtime % 60);
+      bar_color = Color::PAUSE_BAR;
+      break;
+    }
+    case PAUSE:
+      snprintf(buffer, kBufSize, "pause %2d:%02d", remaining / 60,
+               remaining % 60);
+      bar_color = Color::PAUSE_BAR;
+      break;
+    case PAUSE_DONE:
+      snprintf(buffer, kBufSize, "pause OVER");
+      bar_color = Color::PAUSE_OVER_BAR;
+      break;
+    }
+
+    return {.text = buffer,
+            .bar_length = bar_length,
+            .bar_color = bar_color,
+            .pomodoros_done = pomodoros_done};
+  }
+
+  void Draw(Screen &screen, const View &view) const {
+    TRACE_SPAN("Pomodoro::Draw");
+    screen.Print(0, 1, view.text, Style());
+    screen.Print(0, screen.cols() - 2, std::to_string(view.pomodoros_done),
+                 Style());
+    screen.ChangeStyle(0, 0, view.bar_length, {.color = view.bar_color});
+  }
+
+private:
+  using Clock = std::chrono::steady_clock;
+  using TimePoint = std::chrono::time_point<Clock>;
+
+  enum WorkState {
+    WORKING,
+    WORK_DONE,
+    PAUSE,
+    PAUSE_DONE,
+  };
+
+  Pomodoro(State &state, Todo &todo, const TimeSource &clock,
+           std::unique_ptr<TimerWheel> own_timers, TimerWheel *timers,
+           std::function<void()> on_ring)
+      : state_(state), todo_(todo), clock_(clock), timer_(clock),
+        own_timers_(std::move(own_timers)),
+        timers_(timers ? timers : own_timers_.get()),
+        on_ring_(std::move(on_ring)) {
+    if (state_.pomodoro()) {
+      Recover(*state_.pomodoro());
+    }
+  }
+
+  // Continues from a status journaled by a process that is gone, e.g. one
+  // that crashed with a block running. The time since then counts towards
+  // the block, up to its deadline. A block started on another day than the
+  // state's is dropped.
+  void Recover(PomodoroStatus status) {
+    if (status.has_elapsed_seconds()) {
+      const int64_t start_us = status.start_time_us();
+      const std::chrono::seconds local_start(start_us / 1000000 +
+                                             UtcOffsetSeconds(start_us));
+      const std::optional<int> day = ParseDay(state_.day());
+      if (day &&
+          *day != std::chrono::floor<std::chrono::days>(local_start).count()) {
+        return;
+      }
+      const double since_start =
+          (ToEpochMicros(clock_.SystemNow()) - start_us) / 1e6 *
+          clock_.time_scale();
+      status.set_elapsed_seconds(std::max(
+          status.elapsed_seconds(),
+          std::min(since_start, status.target_duration_seconds())));
+    }
+    Restore(status);
+  }
+
+  // Lets the running block ring at its deadline.
+  void ScheduleRing() {
+    CancelRing();
+    if (const std::optional<Timer::TimePoint> deadline = timer_.Deadline()) {
+      ring_timer_ = timers_->Schedule(*deadline, [this] { Ring(); });
+    }
+  }
+  void CancelRing() {
+    if (ring_timer_) {
+      timers_->Cancel(*ring_timer_);
+      ring_timer_.reset();
+    }
+  }
+  void Ring() {
+    ring_timer_.reset();
+    // timer_ keeps track of time on its own, the wheel only says when to look.
+    if (!timer_.IsRinging()) {
+      ScheduleRing();
+      return;
+    }
+    // We're done with the current block.
+    if (work_state == WORKING) {
+      work_state = WORK_DONE;
+    } else if (work_state == PAUSE) {
+      work_state = PAUSE_DONE;
+    }
+    // So that a recovered process does not ring again.
+    state_.SetPomodoro(Status());
+    if (on_ring_) {
+      on_ring_();
+    } else {
+      rang_ = true;
+    }
+  }
+
+  State &state_;
+  Todo &todo_;
+  const TimeSource &clock_;
+  PomodoroTimer timer_;
+  // Null if the caller owns the wheel.
+  std::unique_ptr<TimerWheel> own_timers_;
+  TimerWheel *timers_;
+  std::function<void()> on_ring_;
+  std::optional<TimerWheel::Id> ring_timer_;
+  // Whether the block finished during the current Tick().
+  bool rang_ = false;
+  WorkState work_state = PAUSE_DONE;
+  int pomodoros_done = 0;
+};
+
+void DrawToday(Screen &screen, const State &state);
+
+#endif // POMODORO_UI_H_
@@ -0,0 +1,128 @@
+#include "ui.h"
+
+#include <chrono>
+#include <string>
+
+#include "gtest/gtest.h"
+#include "state.h"
+#include "state.pb.h"
+#include "time_utils.h"
+
+namespace {
+
+using std::chrono::hours;
+using std::chrono::minutes;
+
+// 2021-04-19 10:00 UTC.
+const std::chrono::system_clock::time_point kStart{
+    std::chrono::seconds(1618826400)};
+
+// The local day of `time`, as State keeps it.
+std::string LocalDay(std::chrono::system_clock::time_point time) {
+  const int64_t time_us = ToEpochMicros(time);
+  const std::chrono::seconds local(time_us / 1000000 +
+                                   UtcOffsetSeconds(time_us));
+  return FormatDay(std::chrono::floor<std::chrono::days>(local).count());
+}
+
+class PomodoroRecoveryTest : public testing::Test {
+protected:
+  PomodoroRecoveryTest() : clock_(kStart), state_(MakeProto()), todo_(state_) {}
+
+  static StateProto MakeProto() {
+    StateProto proto;
+    proto.mutable_history()->set_day(LocalDay(kStart));
+    return proto;
+  }
+
+  // Starts work in a process that then goes away without quitting.
+  void StartWorkAndCrash() {
+    Pomodoro pomodoro(state_, todo_, clock_);
+    pomodoro.Start();
+    ASSERT_TRUE(pomodoro.RingTime());
+  }
+
+  SimulatedClock clock_;
+  State state_;
+  Todo todo_;
+};
+
+TEST_F(PomodoroRecoveryTest, ContinuesABlockAfterACrash) {
+  StartWorkAndCrash();
+  clock_.Advance(minutes(10));
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_EQ(pomodoro.GetView(80).text, "work 15:00");
+  EXPECT_TRUE(pomodoro.RingTime());
+}
+
+TEST_F(PomodoroRecoveryTest, CountsOfflineTimeOnlyUpToTheDeadline) {
+  StartWorkAndCrash();
+  clock_.Advance(hours(3));
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_TRUE(pomodoro.Tick());
+  EXPECT_EQ(pomodoro.GetView(80).text, "work DONE (+0:00)");
+  pomodoro.Start();
+  ASSERT_EQ(state_.history().size(), 1u);
+  EXPECT_EQ(state_.history()[0].duration_seconds(), kWorkPhaseSeconds);
+}
+
+TEST_F(PomodoroRecoveryTest, DropsABlockStartedOnAnotherDay) {
+  StartWorkAndCrash();
+  clock_.Advance(hours(24));
+  state_.SetDay(LocalDay(clock_.SystemNow()));
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_FALSE(pomodoro.RingTime());
+  EXPECT_FALSE(pomodoro.Tick());
+  EXPECT_EQ(pomodoro.GetView(80).text, "pause OVER");
+}
+
+TEST_F(PomodoroRecoveryTest, QuitDropsTheRunningBlock) {
+  {
+    Pomodoro pomodoro(state_, todo_, clock_);
+    pomodoro.Start();
+    clock_.Advance(minutes(5));
+    pomodoro.Quit();
+  }
+  clock_.Advance(hours(1));
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_FALSE(pomodoro.RingTime());
+  EXPECT_EQ(pomodoro.GetView(80).text, "pause OVER");
+  EXPECT_TRUE(state_.history().empty());
+}
+
+TEST_F(PomodoroRecoveryTest, QuitBooksFinishedWork) {
+  {
+    Pomodoro pomodoro(state_, todo_, clock_);
+    pomodoro.Start();
+    clock_.Advance(minutes(26));
+    EXPECT_TRUE(pomodoro.Tick());
+    pomodoro.Quit();
+  }
+  ASSERT_EQ(state_.history().size(), 1u);
+  EXPECT_EQ(state_.history()[0].done_type(), Done::WORK);
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_FALSE(pomodoro.RingTime());
+  EXPECT_EQ(pomodoro.Status().pomodoros_done(), 1);
+}
+
+TEST_F(PomodoroRecoveryTest, DoesNotRingTwice) {
+  {
+    Pomodoro pomodoro(state_, todo_, clock_);
+    pomodoro.Start();
+    clock_.Advance(minutes(26));
+    EXPECT_TRUE(pomodoro.Tick());
+  }
+  ASSERT_TRUE(state_.pomodoro());
+  EXPECT_EQ(state_.pomodoro()->work_state(), PomodoroStatus::WORK_DONE);
+
+  Pomodoro pomodoro(state_, todo_, clock_);
+  EXPECT_FALSE(pomodoro.RingTime());
+  EXPECT_FALSE(pomodoro.Tick());
+}
+
+} // namespace